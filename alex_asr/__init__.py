@@ -1,2 +1,2 @@
-from alex_asr.decoder import Decoder
+from alex_asr.decoder import Decoder, DecoderGroup, ModelBundle, StreamScheduler
 import alex_asr.fst as fst
\ No newline at end of file
@@ -2,43 +2,211 @@
 # distutils: language = c++
 from __future__ import unicode_literals
 
+cimport cython
 from cython cimport address
 from libc.stdlib cimport malloc, free
+from libc.string cimport memcpy
+from libc.math cimport log
 from libcpp.vector cimport vector
 from libcpp cimport bool
 from libcpp.string cimport string
+from libcpp.memory cimport shared_ptr
+from cpython.buffer cimport PyObject_GetBuffer, PyBuffer_Release, PyBUF_SIMPLE
+from cpython cimport array
+import array
 
 import alex_asr.fst
 cimport alex_asr.fst._fst
 cimport alex_asr.fst.libfst
 
-from alex_asr.utils import lattice_to_nbest
 
+cdef extern from "src/pcm_convert.h" namespace "alex_asr" nogil:
+    cdef cppclass _PcmFormat "alex_asr::PcmFormat":
+        int bits_per_sample
+        bool is_float
+        int num_channels
+        int channel
+        bool interleaved
+
+
+cdef extern from "src/decoder_stats.h" namespace "alex_asr" nogil:
+    cdef cppclass _StageStats "alex_asr::StageStats":
+        double wall_seconds
+        double cpu_seconds
+        long long count
+
+    cdef cppclass _DecoderStats "alex_asr::DecoderStats":
+        _StageStats pcm_conversion
+        _StageStats features
+        _StageStats likelihoods
+        _StageStats search
+        _StageStats lattice
+        long long samples
+        long long frames_decoded
+        long long arcs_expanded
+        long long max_frame_arcs_expanded
+        long long num_lattices
+        long long raw_lattice_states
+        long long raw_lattice_arcs
+        long long lattice_states
+        long long lattice_arcs
+
+
+cdef extern from "decoder/lattice-faster-decoder.h" namespace "kaldi" nogil:
+    cdef cppclass _LatticeFasterDecoderConfig "kaldi::LatticeFasterDecoderConfig":
+        float beam
+        int max_active
+        int min_active
+        float lattice_beam
+
+
+cdef extern from "src/model_bundle.h" namespace "alex_asr" nogil:
+    cdef cppclass _ModelBundle "alex_asr::ModelBundle":
+        _ModelBundle(string model_path) except +
+
+
+cdef extern from "src/word_table.h" namespace "alex_asr" nogil:
+    cdef cppclass _WordTable "alex_asr::WordTable":
+        int NumIds()
+        const char *Data()
+        const vector[int] &Offsets()
+
+
+cdef extern from "src/decoder.h" namespace "alex_asr" nogil:
+    cdef cppclass _DecodedSegment "alex_asr::DecodedSegment":
+        vector[int] words
+        float cost
+        int start_frame
+        int end_frame
 
-cdef extern from "src/decoder.h" namespace "alex_asr":
     cdef cppclass _Decoder "alex_asr::Decoder":
         _Decoder(string model_path) except +
+        _Decoder(shared_ptr[_ModelBundle] bundle) except +
         size_t Decode(int max_frames) except +
-        void FrameIn(unsigned char *frame, size_t frame_len) except +
+        void FrameIn(const unsigned char *buffer, int buffer_length) except +
         bool GetBestPath(vector[int] *v_out, float *lik) except +
-        bool GetLattice(alex_asr.fst.libfst.LogVectorFst *fst_out, double *tot_lik) except +
+        bool GetBestPathUpdate(int *num_kept, vector[int] *new_words, float *cost,
+                               int *num_stable) except +
+        bool GetLattice(alex_asr.fst.libfst.LogVectorFst *fst_out, double *tot_lik,
+                        bool end_of_utt) except +
+        bool GetNBest(int n, vector[int] *word_ids, vector[int] *offsets, vector[float] *costs,
+                      vector[float] *posteriors, bool end_of_utt) except +
         string GetWord(int word_id) except +
+        bool GetBestPathText(string *text, float *cost) except +
+        bool GetNBestText(int n, string *text, vector[int] *offsets, vector[float] *costs,
+                          vector[float] *posteriors, bool end_of_utt) except +
+        void WordsToText(const vector[int] &word_ids, string *text) except +
+        const _WordTable &GetWordTable() except +
         void InputFinished() except +
         bool EndpointDetected() except +
         void FinalizeDecoding() except +
         void Reset() except +
+        void Reset(const string &speaker_id) except +
+        void ResetWithAdaptation(const string &data) except +
+        void GetAdaptationState(string *data) except +
         float FinalRelativeCost() except +
         int NumFramesDecoded() except +
         int TrailingSilenceLength() except +
+        int OriginalFrame(int frame) except +
+        bool PopSegment(_DecodedSegment *segment) except +
         void GetIvector(vector[float] *ivector) except +
         int GetBitsPerSample() except +
         void SetBitsPerSample(int n_bits) except +
+        void SetPcmFormat(const _PcmFormat &format) except +
+        const _PcmFormat &GetPcmFormat() except +
+        const _DecoderStats &GetStats() except +
+        void ResetStats() except +
+        const _LatticeFasterDecoderConfig &GetSearchOptions() except +
+
+
+cdef extern from "src/decoder_group.h" namespace "alex_asr" nogil:
+    cdef cppclass _DecoderGroup "alex_asr::DecoderGroup":
+        _DecoderGroup(shared_ptr[_ModelBundle] bundle) except +
+        void AddDecoder(_Decoder *decoder) except +
+        void RemoveDecoder(_Decoder *decoder) except +
+        int Decode(int max_frames, vector[int] *num_decoded) except +
+
+
+cdef extern from "src/stream_scheduler.h" namespace "alex_asr" nogil:
+    cdef cppclass _StreamResult "alex_asr::StreamResult":
+        bool is_final
+        bool error
+        float cost
+        int num_frames_decoded
+        vector[int] words
+
+    cdef cppclass _StreamScheduler "alex_asr::StreamScheduler":
+        _StreamScheduler(shared_ptr[_ModelBundle] bundle, int num_threads, bool pin_threads,
+                         int chunk_frames) except +
+        int AddStream() except +
+        void RemoveStream(int stream_id) except +
+        void PushAudio(int stream_id, const unsigned char *buffer, int buffer_length) except +
+        void InputFinished(int stream_id) except +
+        bool PollResult(int stream_id, _StreamResult *result) except +
+
+
+cdef dict _stage_stats_dict(const _StageStats &stats):
+    return {
+        'wall_seconds': stats.wall_seconds,
+        'cpu_seconds': stats.cpu_seconds,
+        'count': stats.count,
+    }
+
+
+cdef array.array _int_array_template = array.array(str('i'), [])
+cdef array.array _float_array_template = array.array(str('f'), [])
+
+
+cdef array.array _int_array(vector[int] &v):
+    cdef array.array res = array.clone(_int_array_template, v.size(), False)
+    if v.size() > 0:
+        memcpy(res.data.as_ints, &v[0], v.size() * sizeof(int))
+    return res
+
+
+cdef array.array _float_array(vector[float] &v):
+    cdef array.array res = array.clone(_float_array_template, v.size(), False)
+    if v.size() > 0:
+        memcpy(res.data.as_floats, &v[0], v.size() * sizeof(float))
+    return res
 
 
 # NOTE: Function signatures as the first line of the docstring are needed in order for
 # sphinx to generate nice documentation.
+cdef class ModelBundle:
+    """Speech recognition models that can be shared by many decoders.
+
+    The bundle is read-only once loaded, so any number of decoders created by
+    `Decoder.from_bundle` can use it at the same time. Loading releases the GIL and reads the
+    models in parallel.
+    """
+
+    cdef shared_ptr[_ModelBundle] thisptr
+
+    def __init__(self, model_path):
+        """__init__(self, model_path)
+        Load speech recognition models.
+
+        Args:
+            model_path (str): Path where the speech recognition models are stored.
+        """
+        cdef string c_model_path = model_path.encode('utf8')
+        cdef _ModelBundle *bundle
+        with nogil:
+            bundle = new _ModelBundle(c_model_path)
+        self.thisptr.reset(bundle)
+
+
 cdef class Decoder:
-    """Speech recognition decoder."""
+    """Speech recognition decoder.
+
+    Thread safety: different decoders can be used from different threads at the same time, also
+    when they share a `ModelBundle`. The methods that do the heavy work (`decode`, `accept_audio`,
+    `get_best_path`, `get_best_path_update`, `get_nbest`, `get_lattice`, `input_finished`,
+    `finalize_decoding` and `reset`) release the GIL, so such threads run in parallel. One decoder must not be used from two threads
+    at once. Loading models (`Decoder(model_path)` and `ModelBundle(model_path)`) releases the GIL
+    too, so models can be loaded from several threads at once.
+    """
 
     cdef _Decoder * thisptr
     cdef utt_decoded
@@ -50,9 +218,32 @@ cdef class Decoder:
         Args:
             model_path (str): Path where the speech recognition models are stored.
         """
-        self.thisptr = new _Decoder(model_path.encode('utf8'))
+        cdef string c_model_path = model_path.encode('utf8')
+        cdef _Decoder *decoder
+        with nogil:
+            decoder = new _Decoder(c_model_path)
+        self.thisptr = decoder
         self.utt_decoded = 0
 
+    @classmethod
+    def from_bundle(cls, ModelBundle bundle not None):
+        """from_bundle(cls, bundle)
+        Create a decoder that uses models from an already loaded bundle.
+
+        Only the per-stream decoding state is allocated; the models are shared with the bundle
+        and all other decoders created from it.
+
+        Args:
+            bundle (ModelBundle): Loaded speech recognition models.
+
+        Returns:
+            Decoder
+        """
+        cdef Decoder decoder = Decoder.__new__(Decoder)
+        decoder.thisptr = new _Decoder(bundle.thisptr)
+        decoder.utt_decoded = 0
+        return decoder
+
     def __dealloc__(self):
         del self.thisptr
 
@@ -66,22 +257,35 @@ cdef class Decoder:
         Returns:
             Number of decoded frames.
         """
-        new_dec = self.thisptr.Decode(max_frames)
+        cdef _Decoder *decoder = self.thisptr
+        cdef int c_max_frames = max_frames
+        cdef size_t new_dec
+        with nogil:
+            new_dec = decoder.Decode(c_max_frames)
         self.utt_decoded += new_dec
         return new_dec
 
-    def accept_audio(self, bytes frame_str):
-        """accept_audio(self, bytes frame_str)
+    def accept_audio(self, frame_str):
+        """accept_audio(self, frame_str)
         Insert given buffer of audio to the decoder for decoding.
 
-        The buffer is interpreted according to the `bits` configuration parameter of the loaded model.
-        Usually `bits=16` therefore bytes is interpreted as an array of 16bit little-endian signed integers.
-        Can be modified by `set_bits_per_sample`.
+        The buffer is interpreted according to the `bits_per_sample`, `sample_format`, `num_channels`,
+        `channel` and `interleaved` configuration parameters of the loaded model. Usually
+        `bits_per_sample=16` therefore bytes is interpreted as an array of 16bit little-endian signed
+        integers. Can be modified by `set_bits_per_sample` and `set_audio_format`.
 
         Args:
-            frame_str (bytes): Audio data.
+            frame_str: Audio data; `bytes` or any other object supporting the buffer protocol
+                (`bytearray`, `memoryview`, `array.array`, numpy arrays, ...). The data is not copied.
         """
-        self.thisptr.FrameIn(frame_str, len(frame_str))
+        cdef _Decoder *decoder = self.thisptr
+        cdef Py_buffer view
+        PyObject_GetBuffer(frame_str, &view, PyBUF_SIMPLE)
+        try:
+            with nogil:
+                decoder.FrameIn(<const unsigned char *>view.buf, view.len)
+        finally:
+            PyBuffer_Release(&view)
 
     def get_best_path(self):
         """get_best_path(self)
@@ -90,42 +294,213 @@ cdef class Decoder:
         Returns:
             tuple: (hypothesis likelihood, list of word id's)
         """
+        cdef _Decoder *decoder = self.thisptr
         cdef vector[int] t
         cdef float lik
-        self.thisptr.GetBestPath(address(t), address(lik))
+        with nogil:
+            decoder.GetBestPath(address(t), address(lik))
         words = [t[i] for i in xrange(t.size())]
         return (lik, words)
 
-    def get_nbest(self, n=1):
-        """get_nbest(self, n=1)
-        Get n best decoding hypotheses (from word posterior lattice).
+    def pop_segment(self):
+        """pop_segment(self)
+        Get the oldest finished segment of the stream.
+
+        With the `continuous` option the search restarts at every endpoint, and with the
+        `max_segment_ms` option at a pause once the current segment is that long, so that the memory
+        of an endless stream stays bounded. The speaker adaptation of the features (CMVN, ivectors)
+        carries over to the next segment. The best paths of the finished segments with any words
+        are queued until they are popped; `get_best_path` and the other results cover only the
+        current segment.
+
+        Returns:
+            tuple: (hypothesis likelihood, list of word id's, start frame, end frame), or None if
+            no segment is finished
+        """
+        cdef _DecodedSegment segment
+        if not self.thisptr.PopSegment(address(segment)):
+            return None
+        words = [segment.words[i] for i in xrange(segment.words.size())]
+        return (segment.cost, words, segment.start_frame, segment.end_frame)
+
+    def get_best_path_update(self, stable=False):
+        """get_best_path_update(self, stable=False)
+        Get the changes of the 1-best hypothesis since the previous call.
+
+        Only the part of the best path that changed since the previous call is traced back, so this
+        is cheap to call after every `decode` even in long utterances.
+
+        Args:
+            stable (bool): Also count the leading words that no further decoding can change, i.e.
+                           the words before the point where the tracebacks of all active search
+                           tokens meet. The count is conservative, as tokens that the search
+                           will still prune count as active. This costs a pass over the raw
+                           lattice of the utterance.
+
+        Returns:
+            tuple (number of words of the previous hypothesis that are unchanged, list of word ids
+            that follow them, cost of the hypothesis, number of stable leading words or None if
+            `stable` is False)
+        """
+        cdef _Decoder *decoder = self.thisptr
+        cdef int num_kept
+        cdef vector[int] new_words
+        cdef float cost
+        cdef int num_stable = 0
+        cdef int *num_stable_out = NULL
+        if stable:
+            num_stable_out = address(num_stable)
+        with nogil:
+            decoder.GetBestPathUpdate(address(num_kept), address(new_words), address(cost),
+                                      num_stable_out)
+        words = [new_words[i] for i in xrange(new_words.size())]
+        return (num_kept, words, cost, num_stable if stable else None)
+
+    def get_nbest(self, n=1, end_of_utterance=True):
+        """get_nbest(self, n=1, end_of_utterance=True)
+        Get n best decoding hypotheses (from the lattice).
 
         Args:
             n (int): How many hypotheses to generate.
+            end_of_utterance (bool): Whether to use the final probabilities of the decoding graph.
 
         Returns:
-            list of hypotheses; each hypothesis is a tuple (hypothesis probability, list of word ids)
+            list of hypotheses, best first; each hypothesis is a tuple (negative log posterior probability
+            of the hypothesis, list of word ids)
         """
-        lik, lat = self.get_lattice()
-        return lattice_to_nbest(lat, n)
+        word_ids, offsets, costs, posteriors = self.get_nbest_arrays(n, end_of_utterance)
+        res = []
+        for i in range(len(costs)):
+            p = posteriors[i]
+            res.append((-log(p) if p > 0 else float('inf'), list(word_ids[offsets[i]:offsets[i + 1]])))
+        return res
+
+    def get_nbest_arrays(self, n=1, end_of_utterance=True):
+        """get_nbest_arrays(self, n=1, end_of_utterance=True)
+        Get n best decoding hypotheses as flat arrays, without creating Python objects per word.
+
+        Args:
+            n (int): How many hypotheses to generate.
+            end_of_utterance (bool): Whether to use the final probabilities of the decoding graph.
 
-    def get_lattice(self):
-        """get_lattice(self)
+        Returns:
+            tuple (word_ids, offsets, costs, posteriors) of `array.array`; hypotheses are sorted best
+            first and words of the i-th one are `word_ids[offsets[i]:offsets[i + 1]]`. `costs` are the
+            graph + acoustic costs and `posteriors` the probabilities of the hypotheses given the lattice.
+        """
+        cdef _Decoder *decoder = self.thisptr
+        cdef int c_n = n
+        cdef bool c_end_of_utterance = end_of_utterance
+        cdef vector[int] word_ids, offsets
+        cdef vector[float] costs, posteriors
+        with nogil:
+            decoder.GetNBest(c_n, &word_ids, &offsets, &costs, &posteriors, c_end_of_utterance)
+        return (_int_array(word_ids), _int_array(offsets), _float_array(costs), _float_array(posteriors))
+
+    def get_lattice(self, end_of_utterance=True):
+        """get_lattice(self, end_of_utterance=True)
         Get word posterior lattice and its likelihood.
 
         NOTE: It may last 100 ms so consideration is needed when used in a timing-critical applications.
+        With the `incremental_lattice` option, repeated calls during an utterance determinize only the
+        audio since the last pause that was already covered by a previous call.
+
+        Args:
+            end_of_utterance (bool): Whether to use the final probabilities of the decoding graph.
+                Pass False for partial results in the middle of an utterance.
 
         Returns:
-            tuple: (lattice likelihood, lattice)
+            tuple: (lattice likelihood, lattice); `lattice.to_arrays()` exports its arcs as flat arrays
+                without creating a Python object per state and arc.
 
         """
+        cdef _Decoder *decoder = self.thisptr
         cdef double lik = -1
+        cdef bool c_end_of_utterance = end_of_utterance
+        cdef alex_asr.fst.libfst.LogVectorFst *fst_out
         r = alex_asr.fst.LogVectorFst()
         if self.utt_decoded > 0:
-            self.thisptr.GetLattice((<alex_asr.fst._fst.LogVectorFst?>r).fst, address(lik))
+            fst_out = (<alex_asr.fst._fst.LogVectorFst?>r).fst
+            with nogil:
+                decoder.GetLattice(fst_out, address(lik), c_end_of_utterance)
         self.utt_decoded = 0
         return (lik, r)
 
+    def get_best_path_text(self):
+        """get_best_path_text(self)
+        Get current 1-best decoding hypothesis as text, in one call.
+
+        Returns:
+            tuple: (hypothesis likelihood, unicode string with the words separated by spaces)
+        """
+        cdef _Decoder *decoder = self.thisptr
+        cdef string text
+        cdef float lik
+        with nogil:
+            decoder.GetBestPathText(address(text), address(lik))
+        return (lik, text.decode('utf8'))
+
+    def get_nbest_text(self, n=1, end_of_utterance=True):
+        """get_nbest_text(self, n=1, end_of_utterance=True)
+        Get n best decoding hypotheses (from the lattice) as text, in one call.
+
+        Args:
+            n (int): How many hypotheses to generate.
+            end_of_utterance (bool): Whether to use the final probabilities of the decoding graph.
+
+        Returns:
+            list of hypotheses, best first; each hypothesis is a tuple (negative log posterior probability
+            of the hypothesis, unicode string with the words separated by spaces)
+        """
+        cdef _Decoder *decoder = self.thisptr
+        cdef int c_n = n
+        cdef bool c_end_of_utterance = end_of_utterance
+        cdef string text
+        cdef vector[int] offsets
+        cdef vector[float] costs, posteriors
+        with nogil:
+            decoder.GetNBestText(c_n, &text, &offsets, &costs, &posteriors, c_end_of_utterance)
+
+        cdef bytes data = text
+        res = []
+        for i in range(costs.size()):
+            p = posteriors[i]
+            hyp = data[offsets[i]:offsets[i + 1]].decode('utf8')
+            res.append((-log(p) if p > 0 else float('inf'), hyp))
+        return res
+
+    def words_to_text(self, word_ids):
+        """words_to_text(self, word_ids)
+        Get the text of a sequence of word ids (e.g. from get_best_path), in one call.
+
+        Args:
+            word_ids (list of int): Word ids.
+
+        Returns:
+            unicode string with the words separated by spaces
+        """
+        cdef vector[int] c_word_ids = word_ids
+        cdef string text
+        self.thisptr.WordsToText(c_word_ids, address(text))
+        return text.decode('utf8')
+
+    def get_word_table(self):
+        """get_word_table(self)
+        Get all the words of the model at once, e.g. to turn word ids to text without calling the
+        decoder.
+
+        Returns:
+            tuple (words, offsets): `words` is bytes with the UTF-8 words concatenated and `offsets` an
+            `array.array` such that word w is `words[offsets[w]:offsets[w + 1]]` (empty for ids that
+            are not words)
+        """
+        cdef const _WordTable *table = &self.thisptr.GetWordTable()
+        cdef vector[int] offsets = table.Offsets()
+        cdef bytes words = b''
+        if offsets.back() > 0:
+            words = table.Data()[:offsets.back()]
+        return (words, _int_array(offsets))
+
     def get_word(self, word_id):
         """get_word(self, word_id)
         Get word string form given word id.
@@ -162,17 +537,61 @@ cdef class Decoder:
     def input_finished(self):
         """input_finished(self)
         Signalize to the decoder that no more input will be added."""
-        self.thisptr.InputFinished()
+        cdef _Decoder *decoder = self.thisptr
+        with nogil:
+            decoder.InputFinished()
 
     def finalize_decoding(self):
         """finalize_decoding(self)
         Finalize the decoding and prepare the internal representation for lattice extration."""
-        self.thisptr.FinalizeDecoding()
+        cdef _Decoder *decoder = self.thisptr
+        with nogil:
+            decoder.FinalizeDecoding()
 
-    def reset(self):
-        """reset(self)
-        Reset the decoder for decoding a new utterance."""
-        self.thisptr.Reset()
+    def reset(self, speaker_id=None, adaptation_state=None):
+        """reset(self, speaker_id=None, adaptation_state=None)
+        Reset the decoder for decoding a new utterance.
+
+        With speaker_id, the features start adapted to the speaker (CMVN statistics, ivector) if an
+        earlier utterance of the speaker was decoded by a decoder of the same model bundle, and the
+        adaptation reached in this utterance is remembered for the speaker's next one (see the
+        `speaker_cache_size` option). With adaptation_state (from get_adaptation_state()), the
+        features start adapted as given instead.
+
+        Args:
+            speaker_id (str): The speaker of the new utterance.
+            adaptation_state (bytes): The adaptation to start with.
+        """
+        cdef _Decoder *decoder = self.thisptr
+        cdef string c_speaker_id
+        cdef string c_state
+        if speaker_id is not None and adaptation_state is not None:
+            raise ValueError("Give either speaker_id or adaptation_state, not both.")
+
+        if speaker_id is not None:
+            c_speaker_id = speaker_id.encode('utf-8')
+            with nogil:
+                decoder.Reset(c_speaker_id)
+        elif adaptation_state is not None:
+            c_state = adaptation_state
+            with nogil:
+                decoder.ResetWithAdaptation(c_state)
+        else:
+            with nogil:
+                decoder.Reset()
+
+    def get_adaptation_state(self):
+        """get_adaptation_state(self)
+        Get the adaptation of the features to the speaker (CMVN statistics, ivector) reached by the
+        frames decoded so far, to be passed to reset(adaptation_state=...) of a decoder of the same
+        model, e.g. in another process.
+
+        Returns:
+            bytes with the serialized state
+        """
+        cdef string data
+        self.thisptr.GetAdaptationState(address(data))
+        return data
 
     def get_final_relative_cost(self):
         """get_final_relative_cost(self)
@@ -187,11 +606,24 @@ cdef class Decoder:
         """get_num_frames_decoded(self)
         Get number of frames decoded so far.
 
+        With the `vad` option the count includes the silence that the VAD dropped, i.e. it is the
+        position in the audio passed to the decoder.
+
         Returns:
             int number of frames decoded
         """
         return self.thisptr.NumFramesDecoded()
 
+    def get_original_frame(self, frame):
+        """get_original_frame(self, frame)
+        Map a frame of the search (e.g. a time in the lattice) to a frame of the audio passed to the
+        decoder. It differs only with the `vad` option, which drops parts of long silences.
+
+        Returns:
+            int frame in the audio passed to the decoder
+        """
+        return self.thisptr.OriginalFrame(frame)
+
     def get_ivector(self):
         """get_ivector(self)
         Get Ivector of the latest decoded frame.
@@ -223,4 +655,248 @@ cdef class Decoder:
         Set number of bits each input sample will have.
         """
 
-        self.thisptr.SetBitsPerSample(n_bits)
\ No newline at end of file
+        self.thisptr.SetBitsPerSample(n_bits)
+
+    def get_audio_format(self):
+        """get_audio_format(self)
+        Get the format of input audio.
+
+        Returns:
+            dict with keys bits_per_sample, is_float, num_channels, channel and interleaved
+        """
+        cdef _PcmFormat format = self.thisptr.GetPcmFormat()
+        return {
+            'bits_per_sample': format.bits_per_sample,
+            'is_float': format.is_float,
+            'num_channels': format.num_channels,
+            'channel': format.channel,
+            'interleaved': format.interleaved,
+        }
+
+    def set_audio_format(self, bits_per_sample=16, is_float=False, num_channels=1, channel=0,
+                         interleaved=True):
+        """set_audio_format(self, bits_per_sample=16, is_float=False, num_channels=1, channel=0, interleaved=True)
+        Set the format of input audio.
+
+        Args:
+            bits_per_sample (int): 8 (unsigned), 16, 24 or 32 (signed integers, or floats in [-1, 1]
+                when `is_float` is set).
+            is_float (bool): Whether the samples are 32-bit floats.
+            num_channels (int): Number of channels in the input.
+            channel (int): Channel that is decoded.
+            interleaved (bool): Whether the channels are interleaved, or planar (each buffer
+                holds the samples of the first channel, then of the second one, ...).
+        """
+        cdef _PcmFormat format
+        format.bits_per_sample = bits_per_sample
+        format.is_float = is_float
+        format.num_channels = num_channels
+        format.channel = channel
+        format.interleaved = interleaved
+        self.thisptr.SetPcmFormat(format)
+
+
+    def get_stats(self):
+        """get_stats(self)
+        Get statistics of the decoder, cumulated since it was created or since `reset_stats`.
+
+        Times of the stages `pcm_conversion`, `features`, `likelihoods`, `search` and `lattice` are
+        exclusive (e.g. features computed for the acoustic model count only as `features`) and are
+        collected only with the `collect_stats` option (on by default).
+
+        Returns:
+            dict; stages map to dicts with `wall_seconds`, `cpu_seconds` and `count` (how many times
+            the stage was entered), the rest are counters: `samples`, `frames_decoded`,
+            `arcs_expanded` (likelihoods requested by the search), `max_frame_arcs_expanded`,
+            `num_lattices` and the sizes of the lattices summed over all of them:
+            `raw_lattice_states`, `raw_lattice_arcs`, `lattice_states`, `lattice_arcs`
+        """
+        cdef _DecoderStats stats = self.thisptr.GetStats()
+        return {
+            'pcm_conversion': _stage_stats_dict(stats.pcm_conversion),
+            'features': _stage_stats_dict(stats.features),
+            'likelihoods': _stage_stats_dict(stats.likelihoods),
+            'search': _stage_stats_dict(stats.search),
+            'lattice': _stage_stats_dict(stats.lattice),
+            'samples': stats.samples,
+            'frames_decoded': stats.frames_decoded,
+            'arcs_expanded': stats.arcs_expanded,
+            'max_frame_arcs_expanded': stats.max_frame_arcs_expanded,
+            'num_lattices': stats.num_lattices,
+            'raw_lattice_states': stats.raw_lattice_states,
+            'raw_lattice_arcs': stats.raw_lattice_arcs,
+            'lattice_states': stats.lattice_states,
+            'lattice_arcs': stats.lattice_arcs,
+        }
+
+    def reset_stats(self):
+        """reset_stats(self)
+        Reset the statistics returned by `get_stats`."""
+        self.thisptr.ResetStats()
+
+    def get_search_options(self):
+        """get_search_options(self)
+        Get the search options in effect. With the `adaptive_beam` option they are narrowed when
+        the decoder falls behind the audio and widened back when it catches up.
+
+        Returns:
+            dict with `beam`, `max_active`, `min_active` and `lattice_beam`
+        """
+        cdef _LatticeFasterDecoderConfig opts = self.thisptr.GetSearchOptions()
+        return {
+            'beam': opts.beam,
+            'max_active': opts.max_active,
+            'min_active': opts.min_active,
+            'lattice_beam': opts.lattice_beam,
+        }
+
+# The C++ group detaches its decoders when destroyed, so the garbage collector must not drop
+# them (through self.decoders) before __dealloc__ runs.
+@cython.no_gc_clear
+cdef class DecoderGroup:
+    """Decodes several streams together, scoring their audio in one batch.
+
+    All decoders in the group have to be created from the same nnet2 `ModelBundle`
+    (see `Decoder.from_bundle`). The pending frames of all of them are scored in
+    one forward pass of the neural network, which uses the CPU much better than
+    scoring each stream on its own.
+    """
+
+    cdef _DecoderGroup * thisptr
+    cdef list decoders
+
+    def __init__(self, ModelBundle bundle not None):
+        """__init__(self, bundle)
+        Create an empty decoder group.
+
+        Args:
+            bundle (ModelBundle): Models of the decoders that will be added to the group.
+        """
+        self.thisptr = new _DecoderGroup(bundle.thisptr)
+        self.decoders = []
+
+    def __dealloc__(self):
+        del self.thisptr
+
+    def add_decoder(self, Decoder decoder not None):
+        """add_decoder(self, decoder)
+        Add a decoder to the group. The decoder is reset.
+
+        Args:
+            decoder (Decoder): Decoder created from the group's bundle.
+        """
+        self.thisptr.AddDecoder(decoder.thisptr)
+        decoder.utt_decoded = 0
+        self.decoders.append(decoder)
+
+    def remove_decoder(self, Decoder decoder not None):
+        """remove_decoder(self, decoder)
+        Remove a decoder from the group. The decoder is reset.
+        """
+        self.thisptr.RemoveDecoder(decoder.thisptr)
+        decoder.utt_decoded = 0
+        self.decoders.remove(decoder)
+
+    def decode(self, max_frames=10):
+        """decode(self, max_frames=10)
+        Score the pending audio of all decoders in one batch and proceed with decoding.
+
+        Args:
+            max_frames (int): Maximum number of frames to decode in each decoder.
+
+        Returns:
+            Total number of decoded frames.
+        """
+        cdef _DecoderGroup *group = self.thisptr
+        cdef int c_max_frames = max_frames
+        cdef vector[int] num_decoded
+        cdef int total
+        with nogil:
+            total = group.Decode(c_max_frames, address(num_decoded))
+        for i, decoder in enumerate(self.decoders):
+            (<Decoder>decoder).utt_decoded += num_decoded[i]
+        return total
+
+
+
+cdef class StreamScheduler:
+    """Decodes many audio streams on a pool of native worker threads.
+
+    Audio is pushed to the streams with `push_audio` and the decoding runs in the background,
+    independently of the Python interpreter, so the decoding of all streams can use every core
+    of the machine. Hypotheses are collected with `poll`.
+    """
+
+    cdef _StreamScheduler * thisptr
+
+    def __init__(self, ModelBundle bundle not None, num_threads, pin_threads=False, chunk_frames=20):
+        """__init__(self, bundle, num_threads, pin_threads=False, chunk_frames=20)
+        Start the worker threads.
+
+        Args:
+            bundle (ModelBundle): Models used for decoding all streams.
+            num_threads (int): Number of worker threads.
+            pin_threads (bool): Pin each worker thread to one CPU (Linux only).
+            chunk_frames (int): Maximum number of frames a worker decodes from one stream before
+                it moves on to another stream.
+        """
+        self.thisptr = new _StreamScheduler(bundle.thisptr, num_threads, pin_threads, chunk_frames)
+
+    def __dealloc__(self):
+        del self.thisptr
+
+    def add_stream(self):
+        """add_stream(self)
+        Add a new stream.
+
+        Returns:
+            int id of the stream
+        """
+        return self.thisptr.AddStream()
+
+    def remove_stream(self, stream_id):
+        """remove_stream(self, stream_id)
+        Remove a stream. Its pending audio and results are dropped."""
+        self.thisptr.RemoveStream(stream_id)
+
+    def push_audio(self, stream_id, frame_str):
+        """push_audio(self, stream_id, frame_str)
+        Queue audio for decoding in the given stream.
+
+        The audio is interpreted the same way as in `Decoder.accept_audio`. Audio pushed after
+        `input_finished` belongs to the next utterance of the stream.
+        """
+        cdef _StreamScheduler *scheduler = self.thisptr
+        cdef int c_stream_id = stream_id
+        cdef Py_buffer view
+        PyObject_GetBuffer(frame_str, &view, PyBUF_SIMPLE)
+        try:
+            with nogil:
+                scheduler.PushAudio(c_stream_id, <const unsigned char *>view.buf, view.len)
+        finally:
+            PyBuffer_Release(&view)
+
+    def input_finished(self, stream_id):
+        """input_finished(self, stream_id)
+        Signalize that the current utterance of the stream has ended.
+
+        When its audio is decoded, a final result is produced and the stream is reset for the
+        next utterance."""
+        self.thisptr.InputFinished(stream_id)
+
+    def poll(self, stream_id):
+        """poll(self, stream_id)
+        Get the results produced for the stream since the last call.
+
+        A result is produced whenever the best hypothesis changes and when an utterance is finished.
+
+        Returns:
+            list of tuples (is_final, hypothesis likelihood, list of word ids, error); error is True
+            if the decoding of the utterance failed (the result is then final and empty)
+        """
+        cdef _StreamResult result
+        results = []
+        while self.thisptr.PollResult(stream_id, address(result)):
+            words = [result.words[i] for i in xrange(result.words.size())]
+            results.append((result.is_final, result.cost, words, result.error))
+        return results
@@ -1,5 +1,5 @@
 from alex_asr.fst._fst import EPSILON, EPSILON_ID, SymbolTable,\
-        read, read_log, read_std, read_symbols, \
+        read, read_log, read_std, read_symbols, std_from_arrays, log_from_arrays, \
         LogWeight, LogArc, LogState, LogVectorFst,\
         TropicalWeight, StdArc, StdState, StdVectorFst, read_symbols_text
 
@@ -4,17 +4,23 @@ cimport sym
 import subprocess
 import random
 import re
+import array
 
 from libcpp.vector cimport vector
 from libcpp.string cimport string
 from libcpp.pair cimport pair
 from libc.stdint cimport uint64_t
 from libc.limits cimport INT_MAX
+from cpython cimport array
+from cpython.buffer cimport PyObject_GetBuffer, PyBuffer_Release, PyBUF_FORMAT, PyBUF_ND
 from util cimport ifstream, ostringstream
 
 EPSILON_ID = 0
 EPSILON = u'\u03b5'
 
+cdef array.array _int_array_template = array.array(str('i'), [])
+cdef array.array _float_array_template = array.array(str('f'), [])
+
 cdef bytes as_str(data):
     if isinstance(data, bytes):
         return data
@@ -51,6 +57,105 @@ def read_log(filename):
     fst._init_tables()
     return fst
 
+cdef class _ArcArrays:
+    """Views of the flat arrays of std_from_arrays()/log_from_arrays(). The buffers are requested
+    without write access, so that read-only arrays are accepted as well."""
+    cdef Py_buffer views[7]
+    cdef int num_views
+    cdef int num_states
+    cdef Py_ssize_t num_arcs
+    cdef const int *sources
+    cdef const int *dests
+    cdef const int *ilabels
+    cdef const int *olabels
+    cdef const float *weights
+    cdef const float *finals
+
+    def __cinit__(self, int start, sources, dests, ilabels, olabels, weights, finals):
+        cdef Py_ssize_t length, i
+        self.num_views = 0
+        self.sources = <const int *>self._get(sources, False, &self.num_arcs)
+        self.dests = <const int *>self._get(dests, False, &length)
+        if length != self.num_arcs:
+            raise ValueError('the arc arrays have different lengths')
+        self.ilabels = <const int *>self._get(ilabels, False, &length)
+        if length != self.num_arcs:
+            raise ValueError('the arc arrays have different lengths')
+        self.olabels = <const int *>self._get(olabels, False, &length)
+        if length != self.num_arcs:
+            raise ValueError('the arc arrays have different lengths')
+        self.weights = <const float *>self._get(weights, True, &length)
+        if length != self.num_arcs:
+            raise ValueError('the arc arrays have different lengths')
+        self.finals = <const float *>self._get(finals, True, &length)
+        if length > INT_MAX:
+            raise ValueError('too many states ({0})'.format(length))
+        self.num_states = length
+
+        if not (-1 <= start < self.num_states):
+            raise ValueError('invalid start state id ({0})'.format(start))
+        for i in range(self.num_arcs):
+            if not (0 <= self.sources[i] < self.num_states and 0 <= self.dests[i] < self.num_states):
+                raise ValueError('invalid state id of arc {0} ({1} -> {2})'.format(
+                    i, self.sources[i], self.dests[i]))
+
+    def __dealloc__(self):
+        cdef int i
+        for i in range(self.num_views):
+            PyBuffer_Release(&self.views[i])
+
+    cdef const void *_get(self, obj, bint is_float, Py_ssize_t *length) except? NULL:
+        cdef Py_buffer *view = &self.views[self.num_views]
+        cdef bytes format = b'B'
+        PyObject_GetBuffer(obj, view, PyBUF_FORMAT | PyBUF_ND)
+        self.num_views += 1
+        if view.format != NULL:
+            format = view.format
+        format = format.lstrip(b'@=')
+        if view.ndim != 1 or view.itemsize != 4 or format not in ((b'f',) if is_float else (b'i', b'l')):
+            raise ValueError('expected a one-dimensional array of 32bit {0}, got format {1!r}'.format(
+                'floats' if is_float else 'ints', format))
+        length[0] = view.shape[0]
+        return view.buf
+
+def std_from_arrays(int start, sources, dests, ilabels, olabels, weights, finals, isyms=None, osyms=None):
+    """std_from_arrays(start, sources, dests, ilabels, olabels, weights, finals, isyms=None, osyms=None)
+    -> StdVectorFst built from the flat arrays of StdVectorFst.to_arrays()
+    The arrays can be any contiguous objects supporting the buffer protocol with 32bit ints
+    (labels, states) or floats (weights), read-only ones included: array.array, numpy arrays, ..."""
+    cdef _ArcArrays arrays = _ArcArrays(start, sources, dests, ilabels, olabels, weights, finals)
+    cdef StdVectorFst result = StdVectorFst(isyms=isyms, osyms=osyms)
+    cdef int s
+    cdef Py_ssize_t i
+    result.fst.ReserveStates(arrays.num_states)
+    for s in range(arrays.num_states):
+        result.fst.AddState()
+        result.fst.SetFinal(s, libfst.MakeTropicalWeight(arrays.finals[s]))
+    for i in range(arrays.num_arcs):
+        result.fst.AddArc(arrays.sources[i], libfst.MakeStdArc(arrays.ilabels[i], arrays.olabels[i],
+            libfst.MakeTropicalWeight(arrays.weights[i]), arrays.dests[i]))
+    result.fst.SetStart(start)
+    return result
+
+def log_from_arrays(int start, sources, dests, ilabels, olabels, weights, finals, isyms=None, osyms=None):
+    """log_from_arrays(start, sources, dests, ilabels, olabels, weights, finals, isyms=None, osyms=None)
+    -> LogVectorFst built from the flat arrays of LogVectorFst.to_arrays()
+    The arrays can be any contiguous objects supporting the buffer protocol with 32bit ints
+    (labels, states) or floats (weights), read-only ones included: array.array, numpy arrays, ..."""
+    cdef _ArcArrays arrays = _ArcArrays(start, sources, dests, ilabels, olabels, weights, finals)
+    cdef LogVectorFst result = LogVectorFst(isyms=isyms, osyms=osyms)
+    cdef int s
+    cdef Py_ssize_t i
+    result.fst.ReserveStates(arrays.num_states)
+    for s in range(arrays.num_states):
+        result.fst.AddState()
+        result.fst.SetFinal(s, libfst.MakeLogWeight(arrays.finals[s]))
+    for i in range(arrays.num_arcs):
+        result.fst.AddArc(arrays.sources[i], libfst.MakeLogArc(arrays.ilabels[i], arrays.olabels[i],
+            libfst.MakeLogWeight(arrays.weights[i]), arrays.dests[i]))
+    result.fst.SetStart(start)
+    return result
+
 def read_symbols(filename):
     """read_symbols(filename) -> SymbolTable read from the binary file"""
     filename = as_str(filename)
@@ -443,6 +548,43 @@ cdef class StdVectorFst(_Fst):
         """fst.add_state() -> new state"""
         return self.fst.AddState()
 
+    def to_arrays(self):
+        """fst.to_arrays() -> (start, sources, dests, ilabels, olabels, weights, finals)
+        export the transducer as flat arrays without creating an object per state or arc:
+        arc i goes from state sources[i] to dests[i] with ilabels[i]:olabels[i] and weights[i]
+        (the arcs of the states in order), finals[s] is the final weight of state s (inf if
+        not final); array.array of ints and floats, usable with numpy.frombuffer"""
+        cdef int num_states = self.fst.NumStates()
+        cdef size_t num_arcs = 0
+        cdef int s
+        for s in range(num_states):
+            num_arcs += self.fst.NumArcs(s)
+
+        cdef array.array sources = array.clone(_int_array_template, num_arcs, False)
+        cdef array.array dests = array.clone(_int_array_template, num_arcs, False)
+        cdef array.array ilabels = array.clone(_int_array_template, num_arcs, False)
+        cdef array.array olabels = array.clone(_int_array_template, num_arcs, False)
+        cdef array.array weights = array.clone(_float_array_template, num_arcs, False)
+        cdef array.array finals = array.clone(_float_array_template, num_states, False)
+
+        cdef libfst.ArcIterator[libfst.StdVectorFst]* it
+        cdef libfst.StdArc* arc
+        cdef size_t i = 0
+        for s in range(num_states):
+            finals.data.as_floats[s] = self.fst.Final(s).Value()
+            it = new libfst.ArcIterator[libfst.StdVectorFst](self.fst[0], s)
+            while not it.Done():
+                arc = <libfst.StdArc*> &it.Value()
+                sources.data.as_ints[i] = s
+                dests.data.as_ints[i] = arc.nextstate
+                ilabels.data.as_ints[i] = arc.ilabel
+                olabels.data.as_ints[i] = arc.olabel
+                weights.data.as_floats[i] = arc.weight.Value()
+                i += 1
+                it.Next()
+            del it
+        return (self.fst.Start(), sources, dests, ilabels, olabels, weights, finals)
+
     def __richcmp__(StdVectorFst x, StdVectorFst y, int op):
         if op == 2: # ==
             return libfst.Equivalent(x.fst[0], y.fst[0]) # FIXME check deterministic eps-free
@@ -1084,6 +1226,43 @@ cdef class LogVectorFst(_Fst):
         """fst.add_state() -> new state"""
         return self.fst.AddState()
 
+    def to_arrays(self):
+        """fst.to_arrays() -> (start, sources, dests, ilabels, olabels, weights, finals)
+        export the transducer as flat arrays without creating an object per state or arc:
+        arc i goes from state sources[i] to dests[i] with ilabels[i]:olabels[i] and weights[i]
+        (the arcs of the states in order), finals[s] is the final weight of state s (inf if
+        not final); array.array of ints and floats, usable with numpy.frombuffer"""
+        cdef int num_states = self.fst.NumStates()
+        cdef size_t num_arcs = 0
+        cdef int s
+        for s in range(num_states):
+            num_arcs += self.fst.NumArcs(s)
+
+        cdef array.array sources = array.clone(_int_array_template, num_arcs, False)
+        cdef array.array dests = array.clone(_int_array_template, num_arcs, False)
+        cdef array.array ilabels = array.clone(_int_array_template, num_arcs, False)
+        cdef array.array olabels = array.clone(_int_array_template, num_arcs, False)
+        cdef array.array weights = array.clone(_float_array_template, num_arcs, False)
+        cdef array.array finals = array.clone(_float_array_template, num_states, False)
+
+        cdef libfst.ArcIterator[libfst.LogVectorFst]* it
+        cdef libfst.LogArc* arc
+        cdef size_t i = 0
+        for s in range(num_states):
+            finals.data.as_floats[s] = self.fst.Final(s).Value()
+            it = new libfst.ArcIterator[libfst.LogVectorFst](self.fst[0], s)
+            while not it.Done():
+                arc = <libfst.LogArc*> &it.Value()
+                sources.data.as_ints[i] = s
+                dests.data.as_ints[i] = arc.nextstate
+                ilabels.data.as_ints[i] = arc.ilabel
+                olabels.data.as_ints[i] = arc.olabel
+                weights.data.as_floats[i] = arc.weight.Value()
+                i += 1
+                it.Next()
+            del it
+        return (self.fst.Start(), sources, dests, ilabels, olabels, weights, finals)
+
     def __richcmp__(LogVectorFst x, LogVectorFst y, int op):
         if op == 2: # ==
             return libfst.Equivalent(x.fst[0], y.fst[0]) # FIXME check deterministic eps-free
@@ -43,6 +43,7 @@ cdef extern from "<fst/fstlib.h>" namespace "fst":
 
     cdef cppclass MutableFst(ExpandedFst):
         int AddState()
+        void ReserveStates(int n)
         void SetFinal(int s, Weight w)
         void SetStart(int s)
         void SetInputSymbols(sym.SymbolTable* isyms)
@@ -91,6 +92,12 @@ cdef extern from "<fst/fstlib.h>" namespace "fst":
 
     ctypedef Arc[LogWeight] LogArc
 
+    # Constructors as functions, to pass temporaries instead of allocating with new
+    cdef TropicalWeight MakeTropicalWeight "fst::TropicalWeight" (float value)
+    cdef StdArc MakeStdArc "fst::StdArc" (int ilabel, int olabel, TropicalWeight& weight, int nextstate)
+    cdef LogWeight MakeLogWeight "fst::LogWeight" (float value)
+    cdef LogArc MakeLogArc "fst::LogArc" (int ilabel, int olabel, LogWeight& weight, int nextstate)
+
 
     cdef cppclass StdVectorFst(MutableFst):
         TropicalWeight Final(int s)
@@ -0,0 +1,54 @@
+#include "src/adaptation_cache.h"
+
+using namespace kaldi;
+
+namespace alex_asr {
+    AdaptationCache::AdaptationCache(const DecoderConfig &config, int32 capacity) :
+            config_(config),
+            capacity_(capacity)
+    { }
+
+    AdaptationCache::~AdaptationCache() {
+        for(Entries::iterator it = entries_.begin(); it != entries_.end(); ++it) {
+            delete it->second;
+        }
+    }
+
+    bool AdaptationCache::Lookup(const std::string &speaker_id, FeatureAdaptationState *state) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::unordered_map<std::string, Entries::iterator>::iterator it = index_.find(speaker_id);
+        if(it == index_.end())
+            return false;
+
+        entries_.splice(entries_.begin(), entries_, it->second);
+        state->CopyFrom(*it->second->second);
+        return true;
+    }
+
+    void AdaptationCache::Store(const std::string &speaker_id, const FeatureAdaptationState &state) {
+        if(capacity_ <= 0)
+            return;
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::unordered_map<std::string, Entries::iterator>::iterator it = index_.find(speaker_id);
+        if(it != index_.end()) {
+            entries_.splice(entries_.begin(), entries_, it->second);
+            it->second->second->CopyFrom(state);
+            return;
+        }
+
+        FeatureAdaptationState *copy;
+        if(static_cast<int32>(entries_.size()) >= capacity_) {
+            // Reuse the least recently used entry.
+            copy = entries_.back().second;
+            index_.erase(entries_.back().first);
+            entries_.pop_back();
+        } else {
+            copy = new FeatureAdaptationState(config_);
+        }
+        copy->CopyFrom(state);
+
+        entries_.push_front(std::make_pair(speaker_id, copy));
+        index_[speaker_id] = entries_.begin();
+    }
+}
@@ -0,0 +1,42 @@
+#ifndef ALEX_ASR_ADAPTATION_CACHE_H_
+#define ALEX_ASR_ADAPTATION_CACHE_H_
+
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include "src/decoder_config.h"
+#include "src/feature_pipeline.h"
+
+using namespace kaldi;
+
+namespace alex_asr {
+    // The feature adaptation states of the recently seen speakers, for
+    // Decoder::Reset(speaker_id). When it is full, the speaker used least
+    // recently is forgotten. Shared by all decoders of a ModelBundle; the
+    // methods are thread-safe.
+    class AdaptationCache {
+    public:
+        AdaptationCache(const DecoderConfig &config, int32 capacity);
+        ~AdaptationCache();
+
+        // Copies the state of the speaker to "state"; false if it is not cached.
+        bool Lookup(const std::string &speaker_id, FeatureAdaptationState *state);
+        void Store(const std::string &speaker_id, const FeatureAdaptationState &state);
+    private:
+        typedef std::list<std::pair<std::string, FeatureAdaptationState *> > Entries;
+
+        const DecoderConfig &config_;
+        int32 capacity_;
+
+        std::mutex mutex_;
+        Entries entries_;  // The most recently used first.
+        std::unordered_map<std::string, Entries::iterator> index_;
+
+        KALDI_DISALLOW_COPY_AND_ASSIGN(AdaptationCache);
+    };
+}
+
+#endif  // ALEX_ASR_ADAPTATION_CACHE_H_
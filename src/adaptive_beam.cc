@@ -0,0 +1,57 @@
+#include <algorithm>
+
+#include "src/adaptive_beam.h"
+
+using namespace kaldi;
+
+namespace alex_asr {
+    // The level is adjusted at most once per this many decoded frames, so that a
+    // single slow Decode() call (e.g. a page fault) does not narrow the search.
+    static const int32 kFramesPerAdjustment = 20;
+    static const BaseFloat kStepDown = 0.15, kStepUp = 0.05;
+    static const BaseFloat kRtfSmoothing = 0.3;  // Weight of the newest measurement.
+
+    AdaptiveBeam::AdaptiveBeam(const LatticeFasterDecoderConfig &opts, BaseFloat min_ratio,
+                               BaseFloat target_rtf, BaseFloat max_backlog_seconds) :
+            max_opts_(opts),
+            min_ratio_(min_ratio),
+            target_rtf_(target_rtf),
+            max_backlog_seconds_(max_backlog_seconds),
+            level_(1.0),
+            average_rtf_(0.0),
+            pending_seconds_(0.0),
+            pending_frames_(0)
+    { }
+
+    bool AdaptiveBeam::Update(double seconds, int32 num_frames, int32 backlog_frames,
+                              BaseFloat frame_shift_seconds, LatticeFasterDecoderConfig *opts) {
+        pending_seconds_ += seconds;
+        pending_frames_ += num_frames;
+        if(pending_frames_ < kFramesPerAdjustment)
+            return false;
+
+        BaseFloat rtf = pending_seconds_ / (pending_frames_ * frame_shift_seconds);
+        average_rtf_ = (average_rtf_ == 0.0) ? rtf : kRtfSmoothing * rtf + (1.0 - kRtfSmoothing) * average_rtf_;
+        pending_seconds_ = 0.0;
+        pending_frames_ = 0;
+
+        BaseFloat backlog_seconds = backlog_frames * frame_shift_seconds;
+        BaseFloat level = level_;
+        if(average_rtf_ > target_rtf_ || backlog_seconds > max_backlog_seconds_) {
+            level = std::max<BaseFloat>(0.0, level_ - kStepDown);
+        } else if(average_rtf_ < 0.8 * target_rtf_ && backlog_seconds < 0.5 * max_backlog_seconds_) {
+            level = std::min<BaseFloat>(1.0, level_ + kStepUp);
+        }
+        if(level == level_)
+            return false;
+        level_ = level;
+
+        BaseFloat ratio = min_ratio_ + (1.0 - min_ratio_) * level_;
+        *opts = max_opts_;
+        opts->beam = max_opts_.beam * ratio;
+        opts->lattice_beam = max_opts_.lattice_beam * ratio;
+        opts->max_active = std::max(opts->min_active,
+                                    static_cast<int32>(max_opts_.max_active * ratio));
+        return true;
+    }
+}
@@ -0,0 +1,46 @@
+#ifndef ALEX_ASR_ADAPTIVE_BEAM_H_
+#define ALEX_ASR_ADAPTIVE_BEAM_H_
+
+#include "base/kaldi-common.h"
+#include "decoder/lattice-faster-decoder.h"
+
+using namespace kaldi;
+
+namespace alex_asr {
+    // Narrows the search when a stream cannot keep up with its audio and widens
+    // it back when it can (--adaptive_beam).
+    //
+    // After every Decode() the controller gets the time it took and the number
+    // of frames still waiting to be decoded. It keeps a moving average of the
+    // real-time factor (decoding time / audio time) and moves a level between
+    // 0 (the narrowest search) and 1 (the configured one): down quickly when the
+    // real-time factor is over --adaptive_target_rtf or the backlog is over
+    // --adaptive_max_backlog_ms, up slowly when both are well below. The beam,
+    // max_active and lattice_beam are interpolated between
+    // --adaptive_min_ratio times the configured value and the configured value.
+    class AdaptiveBeam {
+    public:
+        AdaptiveBeam(const LatticeFasterDecoderConfig &opts, BaseFloat min_ratio,
+                     BaseFloat target_rtf, BaseFloat max_backlog_seconds);
+
+        // Accounts num_frames decoded in "seconds", with backlog_frames left.
+        // Returns true if the options changed; they are then in *opts.
+        bool Update(double seconds, int32 num_frames, int32 backlog_frames,
+                    BaseFloat frame_shift_seconds, LatticeFasterDecoderConfig *opts);
+
+        BaseFloat Level() const { return level_; }
+        BaseFloat AverageRtf() const { return average_rtf_; }
+    private:
+        LatticeFasterDecoderConfig max_opts_;
+        BaseFloat min_ratio_;
+        BaseFloat target_rtf_;
+        BaseFloat max_backlog_seconds_;
+
+        BaseFloat level_;
+        BaseFloat average_rtf_;
+        double pending_seconds_;  // Accumulated since the last adjustment.
+        int32 pending_frames_;
+    };
+}
+
+#endif  // ALEX_ASR_ADAPTIVE_BEAM_H_
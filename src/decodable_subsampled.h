@@ -0,0 +1,45 @@
+#ifndef ALEX_ASR_DECODABLE_SUBSAMPLED_H_
+#define ALEX_ASR_DECODABLE_SUBSAMPLED_H_
+
+#include "base/kaldi-common.h"
+#include "itf/decodable-itf.h"
+
+using namespace kaldi;
+
+namespace alex_asr {
+    // Presents every k-th frame of a decodable, so that the search runs at the
+    // reduced frame rate. Frames that are skipped are never evaluated, which
+    // for decodables that compute likelihoods on demand (GMM) saves the
+    // acoustic model evaluation as well.
+    class DecodableSubsampled : public DecodableInterface {
+    public:
+        DecodableSubsampled(DecodableInterface *decodable, int32 factor) :
+                decodable_(decodable), factor_(factor) {
+            KALDI_ASSERT(factor_ >= 1);
+        }
+
+        virtual BaseFloat LogLikelihood(int32 frame, int32 index) {
+            return decodable_->LogLikelihood(frame * factor_, index);
+        }
+
+        virtual bool IsLastFrame(int32 frame) const {
+            int32 frames_ready = decodable_->NumFramesReady();
+            if((frame + 1) * factor_ < frames_ready)
+                return false;
+            return frames_ready > 0 && decodable_->IsLastFrame(frames_ready - 1);
+        }
+
+        virtual int32 NumFramesReady() const {
+            return (decodable_->NumFramesReady() + factor_ - 1) / factor_;
+        }
+
+        virtual int32 NumIndices() const { return decodable_->NumIndices(); }
+
+        void Reset(DecodableInterface *decodable) { decodable_ = decodable; }
+    private:
+        DecodableInterface *decodable_;
+        int32 factor_;
+    };
+}
+
+#endif  // ALEX_ASR_DECODABLE_SUBSAMPLED_H_
@@ -1,181 +1,478 @@
+#include <algorithm>
+#include <chrono>
+
 #include "src/decoder.h"
 #include "src/utils.h"
+#include "src/word_posteriors.h"
 
-#include "online2/onlinebin-util.h"
+#include "lat/lattice-functions.h"
 
 using namespace kaldi;
 
 namespace alex_asr {
+    template<class Arc>
+    static void CountStatesAndArcs(const fst::ExpandedFst<Arc> &fst, int64 *num_states, int64 *num_arcs) {
+        *num_states += fst.NumStates();
+        for(typename Arc::StateId s = 0; s < fst.NumStates(); s++) {
+            *num_arcs += fst.NumArcs(s);
+        }
+    }
+
     Decoder::Decoder(const string model_path) :
-            feature_pipeline_(NULL),
-            hclg_(NULL),
-            decoder_(NULL),
-            trans_model_(NULL),
-            am_nnet2_(NULL),
-            am_gmm_(NULL),
-            words_(NULL),
-            config_(NULL),
-            decodable_(NULL)
+            bundle_(new ModelBundle(model_path))
+    {
+        Init();
+    }
 
+    Decoder::Decoder(std::shared_ptr<ModelBundle> bundle) :
+            bundle_(bundle)
     {
-        // Change dir to model_path. Change back when leaving the scope.
-        local_cwd cwd_to_model_path(model_path);
-        KALDI_VLOG(2) << "Decoder is setting up models: " << model_path;
+        KALDI_ASSERT(bundle_);
+        Init();
+    }
 
-        ParseConfig();
-        LoadDecoder();
+    void Decoder::Init() {
+        config_ = &bundle_->Config();
+        trans_model_ = &bundle_->TransModel();
+        feature_pipeline_ = NULL;
+        decodable_ = NULL;
+        pcm_format_ = config_->pcm_format;
+        batched_scoring_ = false;
+        decoding_finalized_ = false;
+        nnet2_batched_ = NULL;
+        batched_decodable_ = NULL;
+        subsampled_decodable_ = NULL;
+        incremental_det_ = NULL;
+        timed_feature_ = NULL;
+        timed_decodable_ = NULL;
+        stats_clock_.SetEnabled(config_->collect_stats);
+        search_opts_ = config_->decoder_opts;
+        adaptive_beam_ = NULL;
+        vad_ = NULL;
+
+        if(config_->vad) {
+            vad_ = new EnergyVad(config_->mfcc_opts.frame_opts.samp_freq,
+                                 config_->mfcc_opts.frame_opts.frame_shift_ms,
+                                 config_->vad_threshold_db, config_->vad_max_silence_ms);
+        }
+
+        if(config_->adaptive_beam) {
+            adaptive_beam_ = new AdaptiveBeam(config_->decoder_opts, config_->adaptive_min_ratio,
+                                              config_->adaptive_target_rtf,
+                                              config_->adaptive_max_backlog_ms * 1.0e-03f);
+        }
+
+        if(config_->incremental_lattice) {
+            incremental_det_ = new IncrementalDeterminizer(*trans_model_,
+                                                           config_->decoder_opts.lattice_beam,
+                                                           config_->decoder_opts.det_opts);
+        }
+
+        decoder_ = NULL;  // Created by StartSegment().
         Reset();
 
         KALDI_VLOG(2) << "Decoder is successfully initialized.";
     }
 
     Decoder::~Decoder() {
-        delete feature_pipeline_;
-        delete hclg_;
+        // The last utterance of the speaker is otherwise only stored by Reset().
+        StoreSpeakerAdaptation();
+
+        delete timed_decodable_;
+        delete subsampled_decodable_;
+        if(decodable_ != batched_decodable_) {
+            delete decodable_;
+        }
+        delete batched_decodable_;
+        delete timed_feature_;
+        bundle_->Pipelines().Release(feature_pipeline_);
         delete decoder_;
-        delete trans_model_;
-        delete am_nnet2_;
-        delete am_gmm_;
-        delete words_;
-        delete config_;
-        delete decodable_;
+        delete incremental_det_;
+        delete adaptive_beam_;
+        delete vad_;
     }
 
-    void Decoder::ParseConfig() {
-        KALDI_PARANOID_ASSERT(config_ == NULL);
+    std::shared_ptr<ModelBundle> Decoder::GetModelBundle() {
+        return bundle_;
+    }
+
+    const DecoderStats &Decoder::GetStats() const {
+        return stats_;
+    }
 
-        config_ = new DecoderConfig();
+    void Decoder::ResetStats() {
+        stats_ = DecoderStats();
+    }
 
-        string cfg_name;
-        if(FileExists("pykaldi.cfg")) {
-            cfg_name = "pykaldi.cfg";
-            KALDI_WARN << "Using deprecated configuration file. Please move pykaldi.cfg to alex_asr.conf.";
-        } else if(FileExists("alex_asr.conf")) {
-            cfg_name = "alex_asr.conf";
+    const LatticeFasterDecoderConfig &Decoder::GetSearchOptions() const {
+        return search_opts_;
+    }
+
+    void Decoder::Reset() {
+        StoreSpeakerAdaptation();
+        speaker_id_.clear();
+        ResetStream(NULL);
+    }
+
+    void Decoder::Reset(const std::string &speaker_id) {
+        StoreSpeakerAdaptation();
+        speaker_id_ = speaker_id;
+
+        FeatureAdaptationState adaptation(*config_);
+        if(!speaker_id_.empty() && bundle_->SpeakerCache().Lookup(speaker_id_, &adaptation)) {
+            ResetStream(&adaptation);
         } else {
-            KALDI_ERR << "AlexASR Decoder configuration (alex_asr.conf) not found in model directory."
-                    "Please check your configuration.";
+            ResetStream(NULL);
         }
+    }
 
-        config_->LoadConfigs(cfg_name);
+    void Decoder::ResetWithAdaptation(const FeatureAdaptationState &adaptation) {
+        StoreSpeakerAdaptation();
+        speaker_id_.clear();
+        ResetStream(&adaptation);
+    }
 
-        if(!config_->InitAndCheck()) {
-            KALDI_ERR << "Error when checking if the configuration is valid. "
-                    "Please check your configuration.";
-        }
+    void Decoder::ResetWithAdaptation(const std::string &data) {
+        FeatureAdaptationState adaptation(*config_);
+        adaptation.ReadFromString(data);
+        ResetWithAdaptation(adaptation);
     }
 
-    bool Decoder::FileExists(const std::string& name) {
-        struct stat buffer;
-        return (stat (name.c_str(), &buffer) == 0);
+    void Decoder::GetAdaptationState(FeatureAdaptationState *adaptation) {
+        // Only the decoded frames count; the rest of the audio may still belong
+        // to the next stream's speaker.
+        feature_pipeline_->GetAdaptationState(FeatureFramesDecoded(), adaptation);
     }
 
-    void Decoder::LoadDecoder() {
-        bool binary;
-        Input ki(config_->model_rxfilename, &binary);
+    void Decoder::GetAdaptationState(std::string *data) {
+        FeatureAdaptationState adaptation(*config_);
+        GetAdaptationState(&adaptation);
+        adaptation.WriteToString(data);
+    }
 
-        KALDI_PARANOID_ASSERT(trans_model_ == NULL);
-        trans_model_ = new TransitionModel();
-        trans_model_->Read(ki.Stream(), binary);
+    void Decoder::StoreSpeakerAdaptation() {
+        if(speaker_id_.empty() || feature_pipeline_ == NULL || decoder_ == NULL || decoder_->NumFramesDecoded() == 0)
+            return;
 
-        if(config_->model_type == DecoderConfig::GMM) {
-            KALDI_PARANOID_ASSERT(am_gmm_ == NULL);
-            am_gmm_ = new AmDiagGmm();
-            am_gmm_->Read(ki.Stream(), binary);
-        } else if(config_->model_type == DecoderConfig::NNET2) {
-            KALDI_PARANOID_ASSERT(am_nnet2_ == NULL);
-            am_nnet2_ = new nnet2::AmNnet();
-            am_nnet2_->Read(ki.Stream(), binary);
-        }
+        FeatureAdaptationState adaptation(*config_);
+        GetAdaptationState(&adaptation);
+        bundle_->SpeakerCache().Store(speaker_id_, adaptation);
+    }
 
-        KALDI_PARANOID_ASSERT(hclg_ == NULL);
-        hclg_ = ReadDecodeGraph(config_->fst_rxfilename);
-        KALDI_PARANOID_ASSERT(decoder_ == NULL);
-        decoder_ = new LatticeFasterOnlineDecoder(*hclg_, config_->decoder_opts);
+    void Decoder::ResetStream(const FeatureAdaptationState *adaptation) {
+        StartSegment(adaptation);
 
-        KALDI_PARANOID_ASSERT(words_ == NULL);
-        words_ = fst::SymbolTable::ReadText(config_->words_rxfilename);
+        if(vad_ != NULL) {
+            vad_->Reset();
+        }
+        segment_start_ = 0;
+        input_finished_ = false;
+        replay_.Clear();
+        segments_.clear();
     }
 
-    void Decoder::Reset() {
-        delete feature_pipeline_;
-        delete decodable_;
+    void Decoder::StartSegment(const FeatureAdaptationState *adaptation) {
+        // Kaldi's decodables cannot be reset, so only ours are reused below.
+        if(decodable_ != batched_decodable_) {
+            delete decodable_;
+        }
+        decodable_ = NULL;
+        nnet2_batched_ = NULL;
+
+        // The used pipeline is destroyed and a fresh one prepared off this thread if the bundle pools them.
+        FeaturePipelinePool &pipelines = bundle_->Pipelines();
+        pipelines.Release(feature_pipeline_);
+        feature_pipeline_ = NULL;
+        feature_pipeline_ = pipelines.Acquire();
+        if(adaptation != NULL) {
+            feature_pipeline_->SetAdaptationState(*adaptation);
+        }
 
-        feature_pipeline_ = new FeaturePipeline(*config_);
+        OnlineFeatureInterface *feature = feature_pipeline_->GetFeature();
+        if(stats_clock_.Enabled()) {
+            if(timed_feature_ == NULL) {
+                timed_feature_ = new TimedFeature(feature, &stats_clock_, &stats_);
+            } else {
+                timed_feature_->Reset(feature);
+            }
+            feature = timed_feature_;
+        }
 
+        bool subsampled = config_->frame_subsampling_factor > 1;
+        // Kaldi's decodable can neither subsample nor use the quantized network.
+        bool own_nnet2_scoring = batched_scoring_ || subsampled || config_->quantize_nnet2;
         if(config_->model_type == DecoderConfig::GMM) {
-            decodable_ = new DecodableDiagGmmScaledOnline(*am_gmm_,
+            decodable_ = new DecodableDiagGmmScaledOnline(bundle_->AmGmm(),
                                                           *trans_model_,
                                                           config_->decodable_opts.acoustic_scale,
-                                                          feature_pipeline_->GetFeature());
+                                                          feature);
+            if(subsampled && subsampled_decodable_ == NULL) {
+                subsampled_decodable_ = new DecodableSubsampled(decodable_, config_->frame_subsampling_factor);
+            } else if(subsampled) {
+                subsampled_decodable_->Reset(decodable_);
+            }
+        } else if(config_->model_type == DecoderConfig::NNET2 && own_nnet2_scoring) {
+            if(batched_decodable_ == NULL) {
+                batched_decodable_ = new DecodableNnet2Batched(bundle_->Nnet2Scoring(),
+                                                               *trans_model_,
+                                                               feature);
+            } else {
+                batched_decodable_->Reset(feature);
+            }
+            decodable_ = nnet2_batched_ = batched_decodable_;
         } else if(config_->model_type == DecoderConfig::NNET2) {
-            decodable_ = new nnet2::DecodableNnet2Online(*am_nnet2_,
+            decodable_ = new nnet2::DecodableNnet2Online(bundle_->AmNnet2(),
                                                          *trans_model_,
                                                          config_->decodable_opts,
-                                                         feature_pipeline_->GetFeature());
+                                                         feature);
         } else {
             KALDI_ASSERT(false);  // This means the program is in invalid state.
         }
 
+        if(stats_clock_.Enabled() && timed_decodable_ == NULL) {
+            timed_decodable_ = new TimedDecodable(SearchDecodable(), &stats_clock_, &stats_);
+        } else if(stats_clock_.Enabled()) {
+            timed_decodable_->Reset(SearchDecodable());
+        }
 
-
+        if(incremental_det_ != NULL) {
+            incremental_det_->Reset();
+        }
+        best_path_.Reset();
+        decoding_finalized_ = false;
+
+        // The state table of a composed graph (--hcl, --g) only grows, so
+        // every segment searches a new composition.
+        if(decoder_ == NULL || bundle_->ComposesGraph()) {
+            delete decoder_;
+            graph_ = bundle_->DecodeGraph();
+            decoder_ = new LatticeFasterOnlineDecoder(*graph_, search_opts_);
+        }
         decoder_->InitDecoding();
     }
 
+    DecodableInterface *Decoder::SearchDecodable() {
+        if(subsampled_decodable_ != NULL)
+            return subsampled_decodable_;
+        return decodable_;
+    }
+
+    BaseFloat Decoder::FrameShiftInSeconds() const {
+        return config_->mfcc_opts.frame_opts.frame_shift_ms * 1.0e-03f * config_->frame_subsampling_factor;
+    }
+
+    int64 Decoder::SamplesPerFrame() const {
+        return static_cast<int64>(config_->mfcc_opts.frame_opts.samp_freq
+                                  * config_->mfcc_opts.frame_opts.frame_shift_ms * 1.0e-03)
+               * config_->frame_subsampling_factor;
+    }
+
+    int32 Decoder::FeatureFramesDecoded() {
+        return std::min(decoder_->NumFramesDecoded() * config_->frame_subsampling_factor,
+                        feature_pipeline_->GetFeature()->NumFramesReady());
+    }
+
     bool Decoder::EndpointDetected() {
-        return kaldi::EndpointDetected(config_->endpoint_config, *trans_model_,
-                                       config_->mfcc_opts.frame_opts.frame_shift_ms * 1.0e-03f,
-                                       *decoder_);
+        if(vad_ == NULL && segment_start_ == 0) {
+            return kaldi::EndpointDetected(config_->endpoint_config, *trans_model_,
+                                           FrameShiftInSeconds(), *decoder_);
+        }
+
+        // The rules have to see the silence that the VAD dropped, and measure
+        // the length of the current segment only.
+        int32 num_frames = 0;
+        if(decoder_->NumFramesDecoded() > 0)
+            num_frames = OriginalFrame(decoder_->NumFramesDecoded()) - OriginalFrame(0);
+        int32 trailing_silence = 0;
+        if(config_->endpoint_config.silence_phones != "")
+            trailing_silence = TrailingSilenceLength();
+        return kaldi::EndpointDetected(config_->endpoint_config, num_frames, trailing_silence,
+                                       FrameShiftInSeconds(), decoder_->FinalRelativeCost());
     }
 
     void Decoder::FrameIn(VectorBase<BaseFloat> *waveform_in) {
-        feature_pipeline_->AcceptWaveform(config_->mfcc_opts.frame_opts.samp_freq, *waveform_in);
-    }
-
-    void Decoder::FrameIn(unsigned char *buffer, int32 buffer_length) {
-        int n_frames = buffer_length / (config_->bits_per_sample / 8);
-
-        Vector<BaseFloat> waveform(n_frames);
-
-        for(int32 i = 0; i < n_frames; ++i) {
-            switch(config_->bits_per_sample) {
-                case 8:
-                {
-                    waveform(i) = (*buffer);
-                    buffer++;
-                    break;
-                }
-                case 16:
-                {
-                    int16 k = *reinterpret_cast<uint16*>(buffer);
-#ifdef __BIG_ENDDIAN__
-                    KALDI_SWAP2(k);
-#endif
-                    waveform(i) = k;
-                    buffer += 2;
-                    break;
-                }
-                default:
-                    KALDI_ERR << "Unsupported bits ber sample (implement yourself): "
-                    << config_->bits_per_sample;
+        ScopedStage stage(&stats_clock_, &stats_.features);
+        stats_.samples += waveform_in->Dim();
+
+        if(vad_ != NULL) {
+            vad_buffer_.clear();
+            vad_->AcceptWaveform(*waveform_in, &vad_buffer_);
+            if(!vad_buffer_.empty()) {
+                SubVector<BaseFloat> speech(&vad_buffer_[0], vad_buffer_.size());
+                PipeAudio(speech);
             }
+            return;
         }
+
+        PipeAudio(*waveform_in);
+    }
+
+    bool Decoder::Segmenting() const {
+        return config_->continuous || config_->max_segment_ms > 0;
+    }
+
+    void Decoder::PipeAudio(const VectorBase<BaseFloat> &audio) {
+        if(Segmenting()) {
+            replay_.Append(audio);
+        }
+        feature_pipeline_->AcceptWaveform(config_->mfcc_opts.frame_opts.samp_freq, audio);
+    }
+
+    void Decoder::FrameIn(const unsigned char *buffer, int32 buffer_length) {
+        int32 n_samples = NumPcmSamples(pcm_format_, buffer_length);
+        if(n_samples == 0)
+            return;
+
+        // Convert into a buffer that is only ever grown, so steady-state input does not allocate.
+        {
+            ScopedStage stage(&stats_clock_, &stats_.pcm_conversion);
+            if(pcm_buffer_.Dim() < n_samples) {
+                pcm_buffer_.Resize(n_samples, kUndefined);
+            }
+            ConvertPcm(pcm_format_, buffer, buffer_length, pcm_buffer_.Data());
+        }
+
+        SubVector<BaseFloat> waveform(pcm_buffer_, 0, n_samples);
         this->FrameIn(&waveform);
     }
 
     void Decoder::InputFinished() {
+        ScopedStage stage(&stats_clock_, &stats_.features);
+        if(vad_ != NULL) {
+            vad_buffer_.clear();
+            vad_->InputFinished(&vad_buffer_);
+            if(!vad_buffer_.empty()) {
+                SubVector<BaseFloat> speech(&vad_buffer_[0], vad_buffer_.size());
+                PipeAudio(speech);
+            }
+        }
         feature_pipeline_->InputFinished();
+        input_finished_ = true;
     }
 
     int32 Decoder::Decode(int32 max_frames) {
+        ScopedStage stage(&stats_clock_, &stats_.search);
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
         int32 decoded = decoder_->NumFramesDecoded();
-        decoder_->AdvanceDecoding(decodable_, max_frames);
 
-        return decoder_->NumFramesDecoded() - decoded;
+        if(nnet2_batched_ != NULL) {
+            // Score whatever the group has not scored yet (e.g. when decoding outside of a group).
+            ScopedStage likelihoods_stage(&stats_clock_, &stats_.likelihoods);
+            int32 frame_limit = (max_frames >= 0) ? decoded + max_frames : -1;
+            nnet2_batched_->ScorePending(frame_limit, decoded);
+        }
+
+        if(timed_decodable_ != NULL) {
+            decoder_->AdvanceDecoding(timed_decodable_, max_frames);
+            timed_decodable_->UpdateMaxFrameArcs();
+        } else {
+            decoder_->AdvanceDecoding(SearchDecodable(), max_frames);
+        }
+
+        int32 num_decoded = decoder_->NumFramesDecoded() - decoded;
+        stats_.frames_decoded += num_decoded;
+
+        if(adaptive_beam_ != NULL && num_decoded > 0) {
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            int32 k = config_->frame_subsampling_factor;
+            int32 frames_ready = (feature_pipeline_->GetFeature()->NumFramesReady() + k - 1) / k;
+            int32 backlog = std::max(0, frames_ready - decoder_->NumFramesDecoded());
+            if(adaptive_beam_->Update(seconds, num_decoded, backlog, FrameShiftInSeconds(), &search_opts_)) {
+                decoder_->SetOptions(search_opts_);
+                KALDI_VLOG(3) << "Adaptive search: beam " << search_opts_.beam << ", max_active "
+                              << search_opts_.max_active << ", real-time factor " << adaptive_beam_->AverageRtf();
+            }
+        }
+
+        if(Segmenting() && num_decoded > 0) {
+            replay_.Forget(segment_start_ + decoder_->NumFramesDecoded() * SamplesPerFrame());
+            if(config_->continuous && EndpointDetected()) {
+                Reanchor();
+            } else if(config_->max_segment_ms > 0) {
+                MaybeReanchor();
+            }
+        }
+
+        return num_decoded;
+    }
+
+    void Decoder::MaybeReanchor() {
+        // Segments end at a pause of at least this long if there is one within
+        // half of --max_segment_ms after the limit; otherwise wherever they are.
+        const BaseFloat kPauseSeconds = 0.2;
+
+        int32 num_frames = decoder_->NumFramesDecoded();
+        int32 max_frames = static_cast<int32>(config_->max_segment_ms * 1.0e-03f / FrameShiftInSeconds());
+        if(num_frames < max_frames)
+            return;
+
+        bool at_pause = false;
+        if(config_->endpoint_config.silence_phones != "") {
+            int32 silence = kaldi::TrailingSilenceLength(*trans_model_, config_->endpoint_config.silence_phones,
+                                                         *decoder_);
+            at_pause = silence * FrameShiftInSeconds() >= kPauseSeconds;
+        }
+
+        if(at_pause || num_frames >= max_frames + max_frames / 2) {
+            Reanchor();
+        }
+    }
+
+    void Decoder::Reanchor() {
+        // Everything the search, the features and the lattices keep is per
+        // segment, so starting a new one frees the memory of the old one. Audio
+        // that was passed on but not decoded yet is replayed into the new
+        // pipeline, and what the features adapted to (CMVN statistics, ivector
+        // adaptation) is carried over, as it is the same stream.
+        int32 num_frames = decoder_->NumFramesDecoded();
+
+        DecodedSegment segment;
+        decoder_->FinalizeDecoding();
+        GetBestPath(&segment.words, &segment.cost);
+        segment.start_frame = OriginalFrame(0);
+        segment.end_frame = OriginalFrame(num_frames);
+        // Segments of silence only are not worth reporting.
+        if(!segment.words.empty()) {
+            segments_.push_back(segment);
+        }
+
+        // The last frame of the search may cover less audio than a full frame
+        // (subsampling, --snip_edges=false), so the anchor can pass the audio.
+        int64 anchor = std::min(segment_start_ + num_frames * SamplesPerFrame(), replay_.End());
+        std::vector<BaseFloat> undecoded;
+        replay_.CopyFrom(anchor, &undecoded);
+
+        FeatureAdaptationState adaptation(*config_);
+        feature_pipeline_->GetAdaptationState(FeatureFramesDecoded(), &adaptation);
+
+        StartSegment(&adaptation);
+        segment_start_ = anchor;
+        if(vad_ != NULL) {
+            vad_->ForgetBefore(anchor);
+        }
+
+        if(!undecoded.empty()) {
+            SubVector<BaseFloat> audio(&undecoded[0], undecoded.size());
+            feature_pipeline_->AcceptWaveform(config_->mfcc_opts.frame_opts.samp_freq, audio);
+        }
+        if(input_finished_) {
+            feature_pipeline_->InputFinished();
+        }
+
+        KALDI_VLOG(2) << "Re-anchored the search at frame " << segment.end_frame << ".";
+    }
+
+    bool Decoder::PopSegment(DecodedSegment *segment) {
+        if(segments_.empty())
+            return false;
+        *segment = segments_.front();
+        segments_.pop_front();
+        return true;
     }
 
     void Decoder::FinalizeDecoding() {
         decoder_->FinalizeDecoding();
+        decoding_finalized_ = true;
     }
 
     bool Decoder::GetBestPath(std::vector<int> *out_words, BaseFloat *prob) {
@@ -196,9 +493,98 @@ namespace alex_asr {
         return ok;
     }
 
+    bool Decoder::GetBestPathUpdate(int32 *num_kept, std::vector<int32> *new_words, BaseFloat *cost,
+                                    int32 *num_stable) {
+        if(!decoding_finalized_)
+            return best_path_.Update(*decoder_, true, num_kept, new_words, cost, num_stable);
+
+        // Nothing can change after FinalizeDecoding().
+        bool ok = best_path_.Update(*decoder_, true, num_kept, new_words, cost);
+        if(num_stable != NULL) {
+            *num_stable = best_path_.Words().size();
+        }
+        return ok;
+    }
+
     bool Decoder::GetLattice(fst::VectorFst<fst::LogArc> *fst_out,
                                      double *tot_lik, bool end_of_utterance) {
+        ScopedStage stage(&stats_clock_, &stats_.lattice);
         CompactLattice lat;
+
+        bool ok = GetCompactLattice(&lat, end_of_utterance);
+
+        *tot_lik = CompactLatticeToWordPosteriors(lat, fst_out);
+
+        return ok;
+    }
+
+    bool Decoder::GetNBest(int32 n, std::vector<int32> *word_ids, std::vector<int32> *offsets,
+                           std::vector<BaseFloat> *costs, std::vector<BaseFloat> *posteriors,
+                           bool end_of_utterance) {
+        KALDI_ASSERT(n > 0);
+        ScopedStage stage(&stats_clock_, &stats_.lattice);
+        word_ids->clear();
+        offsets->assign(1, 0);
+        costs->clear();
+        posteriors->clear();
+
+        if(decoder_->NumFramesDecoded() == 0)
+            return false;
+
+        CompactLattice clat;
+        bool ok = GetCompactLattice(&clat, end_of_utterance);
+        if(clat.Start() == fst::kNoStateId)
+            return false;
+
+        RemoveAlignmentsFromCompactLattice(&clat);
+        TopSortCompactLatticeIfNeeded(&clat);
+        Lattice lat;
+        ConvertLattice(clat, &lat);
+
+        // Total log-likelihood of the lattice, for the posteriors.
+        std::vector<double> alpha(lat.NumStates(), kLogZeroDouble);
+        double tot_like = kLogZeroDouble;
+        alpha[lat.Start()] = 0.0;
+        for(Lattice::StateId s = 0; s < lat.NumStates(); s++) {
+            for(fst::ArcIterator<Lattice> aiter(lat, s); !aiter.Done(); aiter.Next()) {
+                const LatticeArc &arc = aiter.Value();
+                double arc_like = -(arc.weight.Value1() + arc.weight.Value2());
+                alpha[arc.nextstate] = LogAdd(alpha[arc.nextstate], alpha[s] + arc_like);
+            }
+            LatticeWeight final_weight = lat.Final(s);
+            if(final_weight != LatticeWeight::Zero()) {
+                tot_like = LogAdd(tot_like, alpha[s] - (final_weight.Value1() + final_weight.Value2()));
+            }
+        }
+
+        Lattice nbest_lat;
+        std::vector<Lattice> nbest_lats;
+        fst::ShortestPath(lat, &nbest_lat, n);
+        fst::ConvertNbestToVector(nbest_lat, &nbest_lats);
+
+        // The paths come in no particular order.
+        std::vector<std::pair<BaseFloat, std::vector<int32> > > hyps(nbest_lats.size());
+        for(size_t i = 0; i < nbest_lats.size(); i++) {
+            LatticeWeight weight;
+            fst::GetLinearSymbolSequence(nbest_lats[i],
+                                         static_cast<vector<int32> *>(0),
+                                         &hyps[i].second,
+                                         &weight);
+            hyps[i].first = weight.Value1() + weight.Value2();
+        }
+        std::sort(hyps.begin(), hyps.end());
+
+        for(size_t i = 0; i < hyps.size(); i++) {
+            word_ids->insert(word_ids->end(), hyps[i].second.begin(), hyps[i].second.end());
+            offsets->push_back(word_ids->size());
+            costs->push_back(hyps[i].first);
+            posteriors->push_back(Exp(-hyps[i].first - tot_like));
+        }
+
+        return ok;
+    }
+
+    bool Decoder::GetCompactLattice(CompactLattice *clat, bool end_of_utterance) {
         Lattice raw_lat;
 
         if (decoder_->NumFramesDecoded() == 0)
@@ -209,17 +595,60 @@ namespace alex_asr {
 
         bool ok = decoder_->GetRawLattice(&raw_lat, end_of_utterance);
 
-        BaseFloat lat_beam = config_->decoder_opts.lattice_beam;
-        DeterminizeLatticePhonePrunedWrapper(
-                *trans_model_, &raw_lat, lat_beam, &lat, config_->decoder_opts.det_opts);
+        if(stats_clock_.Enabled()) {
+            stats_.num_lattices++;
+            CountStatesAndArcs(raw_lat, &stats_.raw_lattice_states, &stats_.raw_lattice_arcs);
+        }
 
-        *tot_lik = CompactLatticeToWordsPost(lat, fst_out);
+        if(incremental_det_ != NULL) {
+            ok &= incremental_det_->Determinize(&raw_lat, clat);
+        } else {
+            BaseFloat lat_beam = config_->decoder_opts.lattice_beam;
+            DeterminizeLatticePhonePrunedWrapper(
+                    *trans_model_, &raw_lat, lat_beam, clat, config_->decoder_opts.det_opts);
+        }
+
+        if(stats_clock_.Enabled()) {
+            CountStatesAndArcs(*clat, &stats_.lattice_states, &stats_.lattice_arcs);
+        }
 
         return ok;
     }
 
     string Decoder::GetWord(int word_id) {
-        return words_->Find(word_id);
+        return bundle_->WordTexts().Word(word_id);
+    }
+
+    bool Decoder::GetBestPathText(std::string *text, BaseFloat *cost) {
+        std::vector<int32> words;
+        bool ok = GetBestPath(&words, cost);
+        WordsToText(words, text);
+        return ok;
+    }
+
+    bool Decoder::GetNBestText(int32 n, std::string *text, std::vector<int32> *offsets,
+                               std::vector<BaseFloat> *costs, std::vector<BaseFloat> *posteriors,
+                               bool end_of_utterance) {
+        std::vector<int32> word_ids, word_offsets;
+        bool ok = GetNBest(n, &word_ids, &word_offsets, costs, posteriors, end_of_utterance);
+
+        const WordTable &words = bundle_->WordTexts();
+        text->clear();
+        offsets->assign(1, 0);
+        for(size_t i = 0; i + 1 < word_offsets.size(); i++) {
+            words.AppendText(word_ids.data() + word_offsets[i], word_offsets[i + 1] - word_offsets[i], text);
+            offsets->push_back(text->size());
+        }
+        return ok;
+    }
+
+    void Decoder::WordsToText(const std::vector<int32> &word_ids, std::string *text) {
+        text->clear();
+        bundle_->WordTexts().AppendText(word_ids, text);
+    }
+
+    const WordTable &Decoder::GetWordTable() {
+        return bundle_->WordTexts();
     }
 
     float Decoder::FinalRelativeCost() {
@@ -227,7 +656,18 @@ namespace alex_asr {
     }
 
     int32 Decoder::NumFramesDecoded() {
-        return decoder_->NumFramesDecoded();
+        int32 num_frames = decoder_->NumFramesDecoded();
+        if(num_frames == 0)
+            return 0;
+        return OriginalFrame(num_frames);
+    }
+
+    int32 Decoder::OriginalFrame(int32 frame) {
+        int64 samples_per_frame = SamplesPerFrame();
+        int64 sample = segment_start_ + frame * samples_per_frame;
+        if(vad_ != NULL)
+            sample = vad_->ToOriginalSample(sample);
+        return static_cast<int32>(sample / samples_per_frame);
     }
 
     int32 Decoder::TrailingSilenceLength() {
@@ -235,11 +675,19 @@ namespace alex_asr {
             KALDI_WARN << "Trying to get training silence length for a model that does not have"
                           "silence phones configured.";
             return -1;
-        } else {
-            return kaldi::TrailingSilenceLength(*trans_model_,
-                                                config_->endpoint_config.silence_phones,
-                                                *decoder_);
         }
+
+        int32 silence = kaldi::TrailingSilenceLength(*trans_model_,
+                                                     config_->endpoint_config.silence_phones,
+                                                     *decoder_);
+        if(vad_ == NULL)
+            return silence;
+
+        // Add the silence that the VAD dropped within the decoded silence and
+        // the silence it holds back after the audio passed on.
+        int32 num_frames = decoder_->NumFramesDecoded();
+        return OriginalFrame(num_frames) - OriginalFrame(num_frames - silence)
+               + vad_->NumSamplesPending() / SamplesPerFrame();
     }
 
     void Decoder::GetIvector(std::vector<float> *ivector) {
@@ -260,12 +708,21 @@ namespace alex_asr {
     }
 
     void Decoder::SetBitsPerSample(int n_bits) {
-        KALDI_ASSERT(n_bits % 8 == 0);
-
-        config_->bits_per_sample = n_bits;
+        PcmFormat format = pcm_format_;
+        format.bits_per_sample = n_bits;
+        SetPcmFormat(format);
     }
 
     int Decoder::GetBitsPerSample() {
-        return config_->bits_per_sample;
+        return pcm_format_.bits_per_sample;
+    }
+
+    void Decoder::SetPcmFormat(const PcmFormat &format) {
+        format.Check();
+        pcm_format_ = format;
+    }
+
+    const PcmFormat &Decoder::GetPcmFormat() {
+        return pcm_format_;
     }
 }
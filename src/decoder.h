@@ -1,12 +1,22 @@
 #ifndef ALEX_ASR_DECODER_
 #define ALEX_ASR_DECODER_
+#include <deque>
 #include <vector>
 #include <memory>
 #include "fst/fst-decl.h"
 #include "base/kaldi-types.h"
 
+#include "src/adaptive_beam.h"
+#include "src/decodable_subsampled.h"
 #include "src/decoder_config.h"
+#include "src/decoder_stats.h"
+#include "src/energy_vad.h"
 #include "src/feature_pipeline.h"
+#include "src/incremental_best_path.h"
+#include "src/incremental_lattice.h"
+#include "src/model_bundle.h"
+#include "src/nnet2_batch.h"
+#include "src/replay_buffer.h"
 
 #include "feat/online-feature.h"
 #include "matrix/matrix-lib.h"
@@ -19,44 +29,170 @@
 using namespace kaldi;
 
 namespace alex_asr {
+    // Part of a stream decoded before the search was re-anchored (--max_segment_ms)
+    // or that ended at an endpoint (--continuous).
+    struct DecodedSegment {
+        std::vector<int32> words;
+        BaseFloat cost;
+        int32 start_frame;  // Frames of the original audio, as NumFramesDecoded().
+        int32 end_frame;
+    };
+
     class Decoder {
     public:
         Decoder(const string model_path);
+        Decoder(std::shared_ptr<ModelBundle> bundle);
         ~Decoder();
 
         int32 Decode(int32 max_frames);
-        void FrameIn(unsigned char *buffer, int32 buffer_length);
+        void FrameIn(const unsigned char *buffer, int32 buffer_length);
         void FrameIn(VectorBase<BaseFloat> *waveform_in);
         bool GetBestPath(std::vector<int> *v_out, BaseFloat *prob);
+        // Like GetBestPath, but reuses the traceback of the previous call: the first num_kept words
+        // of the previously returned path are unchanged and new_words follow them. If num_stable is
+        // not NULL, it receives the number of leading words that no further decoding can change
+        // (see IncrementalBestPath); this costs a pass over the raw lattice.
+        bool GetBestPathUpdate(int32 *num_kept, std::vector<int32> *new_words, BaseFloat *cost,
+                               int32 *num_stable = NULL);
         bool GetLattice(fst::VectorFst<fst::LogArc> * out_fst, double *tot_lik, bool end_of_utt=true);
+        // Up to n best hypotheses from the lattice, best first. Words of the i-th hypothesis are
+        // word_ids[offsets[i]] .. word_ids[offsets[i + 1] - 1]; costs are graph + acoustic costs and
+        // posteriors are the probabilities of the hypotheses given the lattice.
+        bool GetNBest(int32 n, std::vector<int32> *word_ids, std::vector<int32> *offsets,
+                      std::vector<BaseFloat> *costs, std::vector<BaseFloat> *posteriors,
+                      bool end_of_utt=true);
         string GetWord(int word_id);
+        // Text versions of the above: the words are separated by spaces. The
+        // text of the i-th hypothesis is text[offsets[i]] .. text[offsets[i + 1] - 1].
+        bool GetBestPathText(std::string *text, BaseFloat *cost);
+        bool GetNBestText(int32 n, std::string *text, std::vector<int32> *offsets,
+                          std::vector<BaseFloat> *costs, std::vector<BaseFloat> *posteriors,
+                          bool end_of_utt=true);
+        void WordsToText(const std::vector<int32> &word_ids, std::string *text);
+        const WordTable &GetWordTable();
         void InputFinished();
         bool EndpointDetected();
         void FinalizeDecoding();
         void Reset();
+        // Like Reset(), for a stream of a known speaker: the features start
+        // adapted to the speaker (CMVN statistics, ivector) if the bundle's
+        // cache has seen them, and the adaptation reached by the end of the
+        // stream is stored in the cache by the next Reset().
+        void Reset(const std::string &speaker_id);
+        // Like Reset(), with the features starting adapted as given, e.g. by
+        // GetAdaptationState() of an earlier stream of the same speaker.
+        void ResetWithAdaptation(const FeatureAdaptationState &adaptation);
+        void ResetWithAdaptation(const std::string &data);
+        // The adaptation of the features to the speaker so far; the string
+        // version is serialized for ResetWithAdaptation().
+        void GetAdaptationState(FeatureAdaptationState *adaptation);
+        void GetAdaptationState(std::string *data);
         float FinalRelativeCost();
+        // With --vad, frame counts and positions are in the original audio, including the silence
+        // that the VAD dropped; OriginalFrame() maps frames of the search (e.g. lattice times) there.
         int32 NumFramesDecoded();
         int32 TrailingSilenceLength();
+        int32 OriginalFrame(int32 frame);
+        // With --max_segment_ms, the search restarts at a pause once the current segment is that
+        // long; with --continuous, it restarts at every endpoint. The best paths of the finished
+        // segments (except those without words) are returned here, oldest first. The other results
+        // (GetBestPath, GetLattice, EndpointDetected, ...) cover only the current segment.
+        bool PopSegment(DecodedSegment *segment);
         void GetIvector(std::vector<float> *ivector);
         void SetBitsPerSample(int n_bits);
         int GetBitsPerSample();
+        void SetPcmFormat(const PcmFormat &format);
+        const PcmFormat &GetPcmFormat();
+        std::shared_ptr<ModelBundle> GetModelBundle();
+        const DecoderStats &GetStats() const;
+        void ResetStats();
+        // The search options in effect; they change over time with --adaptive_beam.
+        const LatticeFasterDecoderConfig &GetSearchOptions() const;
     private:
-        FeaturePipeline *feature_pipeline_;
+        friend class DecoderGroup;
+
+        // Models shared with other decoders; everything below is per-stream.
+        std::shared_ptr<ModelBundle> bundle_;
+        const DecoderConfig *config_;
+        const TransitionModel *trans_model_;
+        std::shared_ptr<const fst::StdFst> graph_;  // See ModelBundle::DecodeGraph().
 
-        fst::StdFst *hclg_;
+        FeaturePipeline *feature_pipeline_;
         LatticeFasterOnlineDecoder *decoder_;
-        TransitionModel *trans_model_;
-        nnet2::AmNnet *am_nnet2_;
-        AmDiagGmm *am_gmm_;
-        fst::SymbolTable *words_;
-        DecoderConfig *config_;
         DecodableInterface *decodable_;
 
-        void InitTransformMatrices();
-        void LoadDecoder();
-        void ParseConfig();
-        void Deallocate();
-        bool FileExists(const std::string& name);
+        // Format of audio passed to FrameIn and a reusable buffer for its conversion.
+        PcmFormat pcm_format_;
+        Vector<BaseFloat> pcm_buffer_;
+
+        // Set by DecoderGroup; nnet2 log-likelihoods are then computed by
+        // nnet2_batched_ (which is also decodable_) instead of the Kaldi decodable.
+        // The same happens with frame subsampling or a quantized network.
+        bool batched_scoring_;
+        DecodableNnet2Batched *nnet2_batched_;
+        // Owns the nnet2_batched_ of all segments; it is reset rather than recreated.
+        DecodableNnet2Batched *batched_decodable_;
+
+        // With --frame_subsampling_factor > 1, the search reads the GMM decodable
+        // through this wrapper (nnet2_batched_ subsamples on its own).
+        DecodableSubsampled *subsampled_decodable_;
+
+        // Determinizes lattices if --incremental_lattice is set; NULL otherwise.
+        IncrementalDeterminizer *incremental_det_;
+
+        // Traceback kept between GetBestPathUpdate() calls.
+        IncrementalBestPath best_path_;
+        // Set by FinalizeDecoding() until the next segment.
+        bool decoding_finalized_;
+
+        // With --collect_stats, the search reads features and likelihoods
+        // through the timed wrappers, which charge their work to stats_.
+        // Like subsampled_decodable_, they are reset for every segment.
+        DecoderStats stats_;
+        StageClock stats_clock_;
+        TimedFeature *timed_feature_;
+        TimedDecodable *timed_decodable_;
+
+        // With --vad, audio passes through vad_ (into vad_buffer_) before the feature pipeline.
+        EnergyVad *vad_;
+        std::vector<BaseFloat> vad_buffer_;
+
+        // Position of the current segment in the audio passed to the feature
+        // pipelines since Reset() (after the VAD). When segmenting
+        // (--max_segment_ms, --continuous), replay_ holds that audio from the last decoded frame on, for the
+        // pipeline of the next segment.
+        int64 segment_start_;
+        bool input_finished_;
+        ReplayBuffer replay_;
+        std::deque<DecodedSegment> segments_;
+
+        // Speaker of the stream given to Reset(speaker_id); empty if unknown.
+        std::string speaker_id_;
+
+        // With --adaptive_beam, adjusts search_opts_ after every Decode(); NULL otherwise.
+        AdaptiveBeam *adaptive_beam_;
+        LatticeFasterDecoderConfig search_opts_;
+
+        void Init();
+        void ResetStream(const FeatureAdaptationState *adaptation);
+        void StoreSpeakerAdaptation();
+        // Starts a new segment of the stream: new feature pipeline (adapted as
+        // given, if not NULL), decodable and search.
+        void StartSegment(const FeatureAdaptationState *adaptation = NULL);
+        bool Segmenting() const;
+        void PipeAudio(const VectorBase<BaseFloat> &audio);
+        void MaybeReanchor();
+        void Reanchor();
+        // The decodable the search reads (without the timing wrapper).
+        DecodableInterface *SearchDecodable();
+        // Time between two frames of the search.
+        BaseFloat FrameShiftInSeconds() const;
+        // Samples per frame of the search.
+        int64 SamplesPerFrame() const;
+        // Feature frames behind the decoded frames. With subsampling the last
+        // search frame may stand for fewer than k feature frames.
+        int32 FeatureFramesDecoded();
+        bool GetCompactLattice(CompactLattice *clat, bool end_of_utterance);
     };
 
 /// @} end of "addtogroup online_latgen"
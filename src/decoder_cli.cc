@@ -2,82 +2,283 @@
 // Created by zilka on 11/4/15.
 //
 
-#include <fstream>
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
 
 #include "feat/wave-reader.h"
+#include "util/common-utils.h"
 #include "src/decoder.h"
+#include "src/tool_utils.h"
 
 using namespace kaldi;
 using namespace alex_asr;
 
-int main(int argc, const char* const* argv) {
-    Decoder * decoder = new Decoder(argv[2]);
+typedef std::chrono::steady_clock Clock;
 
-    WaveData wave_data;
+// Heap allocations of the calling thread and of the whole process. Reset() is
+// measured on the decoding thread; the work it leaves to the feature pipeline
+// pool (--pipeline_pool_size) is only seen in the count of the process.
+static thread_local int64 num_allocations = 0;
+static std::atomic<int64> process_allocations(0);
 
-    std::filebuf fb;
-    if (fb.open (argv[1], std::ios::in))
-    {
-        std::istream is(&fb);
-        wave_data.Read(is);
+void *operator new(size_t size) {
+    num_allocations++;
+    process_allocations.fetch_add(1, std::memory_order_relaxed);
+    void *p = std::malloc(size == 0 ? 1 : size);
+    if (p == NULL)
+        throw std::bad_alloc();
+    return p;
+}
 
-        fb.close();
-    }
+void operator delete(void *p) noexcept {
+    std::free(p);
+}
 
-    KALDI_LOG << "Initialized.";
+struct BenchmarkOptions {
+    int32 num_threads;
+    BaseFloat chunk_ms;
+    int32 max_frames;
+    bool realtime;
+    bool print_hyps;
 
+    BenchmarkOptions() :
+            num_threads(1),
+            chunk_ms(100.0),
+            max_frames(10),
+            realtime(false),
+            print_hyps(true)
+    { }
 
-//    int32 num_chan = wave_data.Data().NumRows(), this_chan = 0;
-//    if(this_chan != num_chan -1)
-//        KALDI_ERR << "Wave should have only one channel";
-    SubVector<BaseFloat> waveform(wave_data.Data(), 0);
+    void Register(ParseOptions *po) {
+        po->Register("num-threads", &num_threads, "Number of files decoded in parallel.");
+        po->Register("chunk-ms", &chunk_ms, "Audio is passed to the decoder in chunks of this many milliseconds.");
+        po->Register("max-frames", &max_frames, "Maximum number of frames decoded by one Decode() call.");
+        po->Register("realtime", &realtime, "Simulate real-time audio arrival: every chunk is passed to the "
+                "decoder only when it would have been recorded.");
+        po->Register("print-hyps", &print_hyps, "Print the final hypothesis of every file.");
+    }
+};
 
-    for(int k = 0; k < 1; k++) {
-        decoder->Reset();
+struct FileResult {
+    bool ok;
+    double audio_seconds;
+    double busy_seconds;            // Time spent in the decoder (without waiting for audio).
+    double first_partial_seconds;   // From the start of the file to the first non-empty partial result; < 0 if none.
+    double final_seconds;           // From InputFinished() to the final result.
+    double reset_seconds;           // Duration of Decoder::Reset() before the file.
+    int64 reset_allocations;        // Heap allocations made by that Reset().
+    std::vector<double> chunk_latencies;
+    std::string hyp;
+};
 
-        int32 decoded_frames = 0;
-        int32 decoded_now = 0;
-        int32 max_decoded = 10;
+static double Percentile(const std::vector<double> &sorted, double p) {
+    if (sorted.empty())
+        return 0.0;
+    size_t i = static_cast<size_t>(p / 100.0 * sorted.size());
+    return sorted[std::min(i, sorted.size() - 1)];
+}
 
+static void DecodeFile(const BenchmarkOptions &opts, Decoder *decoder, const WaveData &wave,
+                       FileResult *result) {
+    SubVector<BaseFloat> waveform(wave.Data(), 0);
+    BaseFloat samp_freq = wave.SampFreq();
+    int32 chunk_samples = std::max(1, static_cast<int32>(samp_freq * opts.chunk_ms / 1000.0));
 
+    result->audio_seconds = waveform.Dim() / samp_freq;
+    result->busy_seconds = 0.0;
+    result->first_partial_seconds = -1.0;
 
-        decoder->FrameIn(&waveform);
-        decoder->InputFinished();
+    std::vector<int> words;
+    BaseFloat cost;
 
-        vector<int> words;
-        float32 prob;
-        do {
-            decoded_frames += decoded_now;
-            decoded_now = decoder->Decode(max_decoded);
+    Clock::time_point reset_start = Clock::now();
+    int64 allocations = num_allocations;
+    decoder->Reset();
+    result->reset_allocations = num_allocations - allocations;
+    result->reset_seconds = SecondsSince(reset_start);
+    Clock::time_point start = Clock::now();
 
-            decoder->GetBestPath(&words, &prob);
+    for (int32 offset = 0; offset < waveform.Dim(); offset += chunk_samples) {
+        int32 num_samples = std::min(chunk_samples, waveform.Dim() - offset);
 
-            //vector<float> ivector;
-            //decoder->GetIvector(&ivector);
+        // In real time, the chunk is complete when its last sample is recorded.
+        Clock::time_point arrival = Clock::now();
+        if (opts.realtime) {
+            arrival = start + std::chrono::duration_cast<Clock::duration>(
+                    std::chrono::duration<double>((offset + num_samples) / samp_freq));
+            std::this_thread::sleep_until(arrival);
+        }
 
-//            std::cout << "trail_sil " << decoder->TrailingSilenceLength() << " ";
-//            std::cout << "fin_cost " << decoder->FinalRelativeCost() << " ";
-//            std::cout << "dec_frames " << decoder->NumFramesDecoded() << " ";
+        Clock::time_point chunk_start = Clock::now();
+        SubVector<BaseFloat> chunk(waveform, offset, num_samples);
+        decoder->FrameIn(&chunk);
+        while (decoder->Decode(opts.max_frames) > 0) { }
 
-            std::cout << decoded_now << " hyp: ";
-            for (int32 i = 0; i < words.size(); i++) {
-                std::string s = decoder->GetWord(words[i]);
-                std::cout << s << ' ';
+        if (decoder->NumFramesDecoded() > 0) {
+            decoder->GetBestPath(&words, &cost);
+            if (!words.empty() && result->first_partial_seconds < 0) {
+                result->first_partial_seconds = SecondsSince(start);
             }
+        }
 
-//            std::cout << " | Ivector: ";
-//            for(int32 i = 0; i < ivector.size(); i++) {
-//                std::cout << ivector[i] << " ";
-//            }
-            std::cout << std::endl;
-
+        result->busy_seconds += SecondsSince(chunk_start);
+        // Includes the time the chunk waited for the decoder if it falls behind.
+        result->chunk_latencies.push_back(SecondsSince(arrival));
+    }
 
-        } while (decoded_now > 0);
+    Clock::time_point finish_start = Clock::now();
+    decoder->InputFinished();
+    while (decoder->Decode(opts.max_frames) > 0) { }
+    decoder->FinalizeDecoding();
 
-        decoder->FinalizeDecoding();
+    words.clear();
+    if (decoder->NumFramesDecoded() > 0) {
+        decoder->GetBestPath(&words, &cost);
     }
+    result->final_seconds = SecondsSince(finish_start);
+    result->busy_seconds += result->final_seconds;
+    decoder->WordsToText(words, &result->hyp);
+}
+
+int main(int argc, char *argv[]) {
+    try {
+        const char *usage =
+                "Decode WAV files and report throughput and latency of the decoder.\n"
+                "\n"
+                "Usage: decoder_cli [options] <wav-file|wav-list> <model-dir>\n"
+                " e.g.: decoder_cli test.wav model_dir\n"
+                "       decoder_cli --num-threads=8 --realtime=true wavs.txt model_dir\n"
+                "A file not ending in .wav is a list of WAV files, one per line.\n";
+
+        ParseOptions po(usage);
+        BenchmarkOptions opts;
+        opts.Register(&po);
+        po.Read(argc, argv);
+
+        if (po.NumArgs() != 2) {
+            po.PrintUsage();
+            return 1;
+        }
+        KALDI_ASSERT(opts.num_threads > 0 && opts.chunk_ms > 0 && opts.max_frames > 0);
+
+        std::string input = po.GetArg(1),
+                model_dir = po.GetArg(2);
+
+        // Read all audio first so that the disk does not affect the measurements.
+        std::vector<std::string> wav_files;
+        std::vector<WaveData> waves;
+        ReadWaveFiles(input, &wav_files, &waves);
 
-    std::cerr << "Done.";
+        std::shared_ptr<ModelBundle> bundle(new ModelBundle(model_dir));
+        KALDI_LOG << "Initialized.";
 
-    return 0;
-}
\ No newline at end of file
+        std::vector<FileResult> results(wav_files.size());
+        std::atomic<size_t> next_file(0);
+        std::mutex output_mutex;
+
+        Clock::time_point start = Clock::now();
+        int64 start_process_allocations = process_allocations, start_main_allocations = num_allocations;
+        std::atomic<int64> decoding_allocations(0);
+
+        std::vector<std::thread> threads;
+        for (int32 t = 0; t < opts.num_threads; t++) {
+            threads.push_back(std::thread([&]() {
+                {
+                    Decoder decoder(bundle);
+                    for (size_t i = next_file++; i < waves.size(); i = next_file++) {
+                        try {
+                            DecodeFile(opts, &decoder, waves[i], &results[i]);
+                            results[i].ok = true;
+                        } catch (const std::exception &e) {
+                            KALDI_WARN << "Decoding of " << wav_files[i] << " failed: " << e.what();
+                            results[i].ok = false;
+                        }
+
+                        if (opts.print_hyps && results[i].ok) {
+                            std::lock_guard<std::mutex> lock(output_mutex);
+                            std::cout << wav_files[i] << ' ' << results[i].hyp << std::endl;
+                        }
+                    }
+                }
+                // After the decoder is destroyed, which stores its speaker adaptation.
+                decoding_allocations += num_allocations;
+            }));
+        }
+        for (size_t t = 0; t < threads.size(); t++) {
+            threads[t].join();
+        }
+        int64 other_allocations = process_allocations - start_process_allocations - decoding_allocations
+                - (num_allocations - start_main_allocations);
+
+        double wall_seconds = SecondsSince(start);
+
+        int32 num_ok = 0, num_partial = 0;
+        double audio_seconds = 0.0, busy_seconds = 0.0;
+        std::vector<double> chunk_latencies, first_partial, final_latencies, reset_durations;
+        int64 reset_allocations = 0;
+        for (size_t i = 0; i < results.size(); i++) {
+            const FileResult &result = results[i];
+            if (!result.ok)
+                continue;
+            num_ok++;
+            audio_seconds += result.audio_seconds;
+            busy_seconds += result.busy_seconds;
+            chunk_latencies.insert(chunk_latencies.end(), result.chunk_latencies.begin(),
+                                   result.chunk_latencies.end());
+            final_latencies.push_back(result.final_seconds);
+            reset_durations.push_back(result.reset_seconds);
+            reset_allocations += result.reset_allocations;
+            if (result.first_partial_seconds >= 0) {
+                first_partial.push_back(result.first_partial_seconds);
+                num_partial++;
+            }
+        }
+        std::sort(chunk_latencies.begin(), chunk_latencies.end());
+        std::sort(first_partial.begin(), first_partial.end());
+        std::sort(final_latencies.begin(), final_latencies.end());
+        std::sort(reset_durations.begin(), reset_durations.end());
+
+        struct rusage usage_stats;
+        getrusage(RUSAGE_SELF, &usage_stats);
+
+        KALDI_LOG << "Decoded " << num_ok << " of " << results.size() << " files, "
+                  << audio_seconds << " s of audio in " << wall_seconds << " s with "
+                  << opts.num_threads << " threads.";
+        if (audio_seconds > 0) {
+            KALDI_LOG << "Real-time factor: " << busy_seconds / audio_seconds << " per stream (decoder time / audio), "
+                      << wall_seconds / audio_seconds << " overall (wall time / audio).";
+        }
+        KALDI_LOG << "Chunk latency (ms): p50 " << 1000 * Percentile(chunk_latencies, 50)
+                  << ", p95 " << 1000 * Percentile(chunk_latencies, 95)
+                  << ", p99 " << 1000 * Percentile(chunk_latencies, 99);
+        KALDI_LOG << "Time to first partial result (ms, " << num_partial << " files): p50 "
+                  << 1000 * Percentile(first_partial, 50)
+                  << ", p95 " << 1000 * Percentile(first_partial, 95)
+                  << ", p99 " << 1000 * Percentile(first_partial, 99);
+        KALDI_LOG << "Final result latency after InputFinished (ms): p50 " << 1000 * Percentile(final_latencies, 50)
+                  << ", p95 " << 1000 * Percentile(final_latencies, 95)
+                  << ", p99 " << 1000 * Percentile(final_latencies, 99);
+        if (num_ok > 0) {
+            KALDI_LOG << "Decoder::Reset(): " << static_cast<double>(reset_allocations) / num_ok
+                      << " heap allocations on the decoding thread on average, p50 "
+                      << 1000 * Percentile(reset_durations, 50) << " ms, p99 "
+                      << 1000 * Percentile(reset_durations, 99) << " ms";
+            KALDI_LOG << "Heap allocations of other threads (feature pipeline pool): "
+                      << static_cast<double>(other_allocations) / num_ok << " per file";
+        }
+        KALDI_LOG << "Peak RSS: " << usage_stats.ru_maxrss / 1024.0 << " MB";
+
+        return num_ok == static_cast<int32>(results.size()) ? 0 : 1;
+    } catch (const std::exception &e) {
+        std::cerr << e.what();
+        return -1;
+    }
+}
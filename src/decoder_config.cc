@@ -7,10 +7,31 @@ namespace alex_asr {
             cmvn_mat(NULL),
             ivector_extraction_info(NULL),
             bits_per_sample(16),
+            sample_format("int"),
+            num_channels(1),
+            channel(0),
+            interleaved(true),
             use_lda(true),
             use_ivectors(false),
             use_cmvn(false),
             use_pitch(false),
+            use_hclg_mmap(false),
+            compose_cache_mb(256),
+            pipeline_pool_size(0),
+            incremental_lattice(false),
+            collect_stats(true),
+            frame_subsampling_factor(1),
+            quantize_nnet2(false),
+            adaptive_beam(false),
+            adaptive_target_rtf(0.8),
+            adaptive_max_backlog_ms(300.0),
+            adaptive_min_ratio(0.5),
+            vad(false),
+            vad_threshold_db(10.0),
+            vad_max_silence_ms(600.0),
+            max_segment_ms(0.0),
+            continuous(false),
+            speaker_cache_size(100),
             cfg_decoder(""),
             cfg_decodable(""),
             cfg_mfcc(""),
@@ -18,7 +39,8 @@ namespace alex_asr {
             cfg_splice(""),
             cfg_endpoint(""),
             cfg_ivector(""),
-            cfg_pitch("")
+            cfg_pitch(""),
+            package_(NULL)
     {
         decodable_opts.acoustic_scale = 0.1;
         splice_opts.left_context = 3;
@@ -35,6 +57,8 @@ namespace alex_asr {
         po->Register("model_type", &model_type_str, "Type of model. GMM/NNET2");
         po->Register("model", &model_rxfilename, "Accoustic model filename.");
         po->Register("hclg", &fst_rxfilename, "HCLG FST filename.");
+        po->Register("hcl", &hcl_rxfilename, "HCL FST filename; composed with --g during decoding instead of --hclg.");
+        po->Register("g", &g_rxfilename, "G FST filename (with --hcl).");
         po->Register("words", &words_rxfilename, "Word to ID mapping filename.");
         po->Register("mat_lda", &lda_mat_rspecifier, "LDA matrix filename.");
         po->Register("mat_cmvn", &fcmvn_mat_rspecifier, "CMVN matrix filename.");
@@ -42,7 +66,28 @@ namespace alex_asr {
         po->Register("use_ivectors", &use_ivectors, "Are we using ivector features?");
         po->Register("use_cmvn", &use_cmvn, "Are we using cmvn transform?");
         po->Register("use_pitch", &use_pitch, "Are we using pitch feature?");
-        po->Register("bits_per_sample", &bits_per_sample, "Bits per sample for input.");
+        po->Register("use_hclg_mmap", &use_hclg_mmap, "Is --hclg (or --hcl and --g) in the memory mappable format (see hclg_to_mmap)?");
+        po->Register("compose_cache_mb", &compose_cache_mb, "Memory (MB) of the arcs of the --hcl and --g composition each decoder caches.");
+        po->Register("pipeline_pool_size", &pipeline_pool_size, "Number of feature pipelines prepared in the background for Decoder::Reset (0 = none).");
+        po->Register("incremental_lattice", &incremental_lattice, "Determinize lattices of an utterance incrementally, reusing the part before the last pause?");
+        po->Register("collect_stats", &collect_stats, "Measure the time spent in the stages of decoding (see Decoder::GetStats)?");
+        po->Register("frame_subsampling_factor", &frame_subsampling_factor, "Score and search only every k-th frame (1 = all frames).");
+        po->Register("quantize_nnet2", &quantize_nnet2, "Compute the affine layers of nnet2 models with int8 weights (faster, slightly less accurate)?");
+        po->Register("adaptive_beam", &adaptive_beam, "Narrow the search (beam, max_active, lattice_beam) when decoding falls behind the audio?");
+        po->Register("adaptive_target_rtf", &adaptive_target_rtf, "Real-time factor the adaptive search keeps each stream under.");
+        po->Register("adaptive_max_backlog_ms", &adaptive_max_backlog_ms, "Audio waiting to be decoded (ms) above which the adaptive search narrows.");
+        po->Register("adaptive_min_ratio", &adaptive_min_ratio, "The narrowest adaptive search, as a fraction of the configured beam, max_active and lattice_beam.");
+        po->Register("vad", &vad, "Shorten long non-speech regions of the input before computing features?");
+        po->Register("vad_threshold_db", &vad_threshold_db, "Energy over the noise floor (dB) at which a frame is speech.");
+        po->Register("vad_max_silence_ms", &vad_max_silence_ms, "Non-speech regions are shortened to this length (ms).");
+        po->Register("max_segment_ms", &max_segment_ms, "Restart the search after this much audio (ms), at the next pause, to keep the memory of endless streams bounded (0 = never).");
+        po->Register("continuous", &continuous, "Split the stream into segments at endpoints internally, carrying the CMVN and ivector adaptation over (see Decoder::PopSegment)?");
+        po->Register("speaker_cache_size", &speaker_cache_size, "Number of speakers whose CMVN and ivector adaptation is remembered for Decoder::Reset(speaker_id) (0 = none).");
+        po->Register("bits_per_sample", &bits_per_sample, "Bits per sample for input (8/16/24/32).");
+        po->Register("sample_format", &sample_format, "Format of input samples: int/float (float needs 32 bits).");
+        po->Register("num_channels", &num_channels, "Number of channels of input audio.");
+        po->Register("channel", &channel, "Channel of input audio that is decoded (0-based).");
+        po->Register("interleaved", &interleaved, "Are the channels interleaved (true) or planar (false)?");
 
         po->Register("cfg_decoder", &cfg_decoder, "");
         po->Register("cfg_decodable", &cfg_decodable, "");
@@ -54,15 +99,29 @@ namespace alex_asr {
         po->Register("cfg_pitch", &cfg_pitch, "");
     }
 
-    void DecoderConfig::LoadConfigs(const string cfg_file) {
-        std::string model_path("");
+    // Makes a relative filename relative to dir; pipes and stdin stay as they are.
+    static void ResolvePath(const string &dir, string *rxfilename) {
+        if(dir.empty() || rxfilename->empty() || *rxfilename == "-" || (*rxfilename)[0] == '/'
+           || (*rxfilename)[rxfilename->size() - 1] == '|')
+            return;
+        *rxfilename = dir + "/" + *rxfilename;
+    }
 
+    void DecoderConfig::LoadConfigs(const string &model_dir, const string &cfg_name) {
         ParseOptions po("");
         Register(&po);
 
+        string cfg_file = cfg_name;
+        ResolvePath(model_dir, &cfg_file);
         KALDI_VLOG(2) << "Reading master config file: " << cfg_file;
         po.ReadConfigFile(cfg_file);
 
+        string *cfg_files[] = {&cfg_decoder, &cfg_decodable, &cfg_mfcc, &cfg_cmvn, &cfg_splice,
+                               &cfg_endpoint, &cfg_ivector, &cfg_pitch};
+        for(size_t i = 0; i < sizeof(cfg_files) / sizeof(cfg_files[0]); i++) {
+            ResolvePath(model_dir, cfg_files[i]);
+        }
+
         LoadConfig(cfg_decoder, &decoder_opts);
         LoadConfig(cfg_decodable, &decodable_opts);
         LoadConfig(cfg_mfcc, &mfcc_opts);
@@ -73,7 +132,53 @@ namespace alex_asr {
         LoadConfig(cfg_pitch, &pitch_opts);
         LoadConfig(cfg_pitch, &pitch_process_opts);
 
-        InitAux();
+        string *model_files[] = {&model_rxfilename, &fst_rxfilename, &hcl_rxfilename, &g_rxfilename,
+                                 &words_rxfilename, &lda_mat_rspecifier, &fcmvn_mat_rspecifier,
+                                 &ivector_config.lda_mat_rxfilename,
+                                 &ivector_config.global_cmvn_stats_rxfilename,
+                                 &ivector_config.cmvn_config_rxfilename,
+                                 &ivector_config.splice_config_rxfilename,
+                                 &ivector_config.diag_ubm_rxfilename,
+                                 &ivector_config.ivector_extractor_rxfilename};
+        for(size_t i = 0; i < sizeof(model_files) / sizeof(model_files[0]); i++) {
+            ResolvePath(model_dir, model_files[i]);
+        }
+    }
+
+    void DecoderConfig::LoadPackage(const ModelPackage &package) {
+        KALDI_VLOG(2) << "Reading configuration from model package: " << package.FileName();
+        package_ = &package;
+        package.LoadOptions("alex_asr.conf", this);
+
+        package.LoadOptions("cfg_decoder", &decoder_opts);
+        package.LoadOptions("cfg_decodable", &decodable_opts);
+        package.LoadOptions("cfg_mfcc", &mfcc_opts);
+        package.LoadOptions("cfg_cmvn", &cmvn_opts);
+        package.LoadOptions("cfg_splice", &splice_opts);
+        package.LoadOptions("cfg_endpoint", &endpoint_config);
+        package.LoadOptions("cfg_ivector", &ivector_config);
+        package.LoadOptions("cfg_pitch", &pitch_opts);
+        package.LoadOptions("cfg_pitch", &pitch_process_opts);
+
+        // The filenames in the options refer to the model directory the package
+        // was created from.
+        model_rxfilename = package.Rxfilename("model");
+        if(package.Has("hcl")) {
+            hcl_rxfilename = package.Rxfilename("hcl");
+            g_rxfilename = package.Rxfilename("g");
+        } else {
+            fst_rxfilename = package.Rxfilename("hclg");
+        }
+        words_rxfilename = package.Rxfilename("words");
+        use_hclg_mmap = true;
+
+        if(use_lda) {
+            lda_mat_rspecifier = package.Rxfilename("mat_lda");
+        }
+
+        if(use_cmvn) {
+            fcmvn_mat_rspecifier = package.Rxfilename("mat_cmvn");
+        }
     }
 
     void DecoderConfig::InitAux() {
@@ -85,7 +190,9 @@ namespace alex_asr {
             LoadCMVN();
         }
 
-        if (use_ivectors) {
+        if (use_ivectors && package_ != NULL) {
+            LoadIvector(*package_);
+        } else if (use_ivectors) {
             LoadIvector();
         }
     }
@@ -115,6 +222,32 @@ namespace alex_asr {
         ivector_extraction_info = new OnlineIvectorExtractionInfo(ivector_config);
     }
 
+    void DecoderConfig::LoadIvector(const ModelPackage &package) {
+        KALDI_LOG << "Loading IVector extraction info from the model package.";
+
+        // What OnlineIvectorExtractionInfo::Init() does, except that the config
+        // files of the extractor's CMVN and splicing are in the package too.
+        OnlineIvectorExtractionInfo *info = new OnlineIvectorExtractionInfo();
+        ivector_extraction_info = info;
+        info->ivector_period = ivector_config.ivector_period;
+        info->num_gselect = ivector_config.num_gselect;
+        info->min_post = ivector_config.min_post;
+        info->posterior_scale = ivector_config.posterior_scale;
+        info->max_remembered_frames = ivector_config.max_remembered_frames;
+        info->max_count = ivector_config.max_count;
+        info->num_cg_iters = ivector_config.num_cg_iters;
+        info->use_most_recent_ivector = ivector_config.use_most_recent_ivector || ivector_config.greedy_ivector_extractor;
+        info->greedy_ivector_extractor = ivector_config.greedy_ivector_extractor;
+
+        ReadKaldiObject(package.Rxfilename("ivector_lda"), &info->lda_mat);
+        ReadKaldiObject(package.Rxfilename("ivector_cmvn_stats"), &info->global_cmvn_stats);
+        package.LoadOptions("ivector_cmvn_config", &info->cmvn_opts);
+        package.LoadOptions("ivector_splice_config", &info->splice_opts);
+        ReadKaldiObject(package.Rxfilename("ivector_diag_ubm"), &info->diag_ubm);
+        ReadKaldiObject(package.Rxfilename("ivector_extractor"), &info->extractor);
+        info->Check();
+    }
+
     template<typename C>
     void DecoderConfig::LoadConfig(string file_name, C *opts) {
         if (FileExists(file_name)) {
@@ -174,8 +307,14 @@ namespace alex_asr {
         res &= OptionCheck(model_rxfilename == "",
                            "You have to specify --model.");
 
-        res &= OptionCheck(fst_rxfilename == "",
-                           "You have to specify --hclg.");
+        res &= OptionCheck(fst_rxfilename == "" && hcl_rxfilename == "",
+                           "You have to specify --hclg (or --hcl and --g).");
+        res &= OptionCheck(fst_rxfilename != "" && hcl_rxfilename != "",
+                           "You have to specify either --hclg or --hcl, not both.");
+        res &= OptionCheck((hcl_rxfilename == "") != (g_rxfilename == ""),
+                           "You have to specify both --hcl and --g.");
+        res &= OptionCheck(compose_cache_mb < 1,
+                           "--compose_cache_mb has to be positive.");
 
         res &= OptionCheck(words_rxfilename == "",
                            "You have to specify --words.");
@@ -183,6 +322,31 @@ namespace alex_asr {
         res &= OptionCheck(use_lda && lda_mat_rspecifier == "",
                            "You have to specify --mat_lda or set --use_lda=false.");
 
+        res &= OptionCheck(frame_subsampling_factor < 1,
+                           "You have to specify --frame_subsampling_factor >= 1.");
+        res &= OptionCheck(adaptive_beam && (adaptive_min_ratio <= 0.0 || adaptive_min_ratio > 1.0),
+                           "You have to specify 0 < --adaptive_min_ratio <= 1.");
+        res &= OptionCheck(adaptive_beam && (adaptive_target_rtf <= 0.0 || adaptive_max_backlog_ms <= 0.0),
+                           "You have to specify positive --adaptive_target_rtf and --adaptive_max_backlog_ms.");
+        res &= OptionCheck(vad && vad_max_silence_ms < 2 * mfcc_opts.frame_opts.frame_shift_ms,
+                           "You have to specify --vad_max_silence_ms of at least two frames.");
+        res &= OptionCheck(max_segment_ms < 0.0,
+                           "You have to specify --max_segment_ms >= 0.");
+        res &= OptionCheck(speaker_cache_size < 0,
+                           "--speaker_cache_size has to be non-negative.");
+        res &= OptionCheck(pipeline_pool_size < 0,
+                           "--pipeline_pool_size has to be non-negative.");
+
+        res &= OptionCheck(sample_format != "int" && sample_format != "float",
+                           "--sample_format has to be int or float.");
+
+        pcm_format.bits_per_sample = bits_per_sample;
+        pcm_format.is_float = (sample_format == "float");
+        pcm_format.num_channels = num_channels;
+        pcm_format.channel = channel;
+        pcm_format.interleaved = interleaved;
+        pcm_format.Check();
+
         return res;
     }
 
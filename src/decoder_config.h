@@ -12,6 +12,8 @@
 #include "online2/online-endpoint.h"
 #include "online2/online-ivector-feature.h"
 #include "util/stl-utils.h"
+#include "src/model_package.h"
+#include "src/pcm_convert.h"
 #include "src/utils.h"
 
 using namespace kaldi;
@@ -24,7 +26,15 @@ namespace alex_asr {
         DecoderConfig();
         ~DecoderConfig();
         void Register(ParseOptions *po);
-        void LoadConfigs(const string cfg_file);
+        // Reads the options from cfg_name in model_dir and the cfg_* files it
+        // names. Relative filenames in the options are relative to model_dir.
+        void LoadConfigs(const string &model_dir, const string &cfg_name);
+        // Reads the options from a package written by pack_model; the model
+        // filenames then refer to its entries. The package must outlive InitAux().
+        void LoadPackage(const ModelPackage &package);
+        // Loads the LDA, CMVN and ivector extractor the options name. Separate
+        // from the two above so that it can run along with loading other models.
+        void InitAux();
         bool InitAndCheck();
 
         LatticeFasterDecoderConfig decoder_opts;
@@ -43,12 +53,34 @@ namespace alex_asr {
 
         ModelType model_type;
         int32 bits_per_sample;
+        std::string sample_format;
+        int32 num_channels;
+        int32 channel;
+        bool interleaved;
+        PcmFormat pcm_format;  // Built from the options above by InitAndCheck().
 
         bool use_lda;
         bool use_splice;
         bool use_ivectors;
         bool use_cmvn;
         bool use_pitch;
+        bool use_hclg_mmap;
+        int32 compose_cache_mb;
+        int32 pipeline_pool_size;
+        bool incremental_lattice;
+        bool collect_stats;
+        int32 frame_subsampling_factor;
+        bool quantize_nnet2;
+        bool adaptive_beam;
+        BaseFloat adaptive_target_rtf;
+        BaseFloat adaptive_max_backlog_ms;
+        BaseFloat adaptive_min_ratio;
+        bool vad;
+        BaseFloat vad_threshold_db;
+        BaseFloat vad_max_silence_ms;
+        BaseFloat max_segment_ms;
+        bool continuous;
+        int32 speaker_cache_size;
 
         std::string cfg_decoder;
         std::string cfg_decodable;
@@ -61,19 +93,23 @@ namespace alex_asr {
 
         std::string model_rxfilename;
         std::string fst_rxfilename;
+        // Instead of fst_rxfilename: HCL and G composed during the search.
+        std::string hcl_rxfilename;
+        std::string g_rxfilename;
         std::string words_rxfilename;
         std::string lda_mat_rspecifier;
         std::string fcmvn_mat_rspecifier;
     private:
-        void InitAux();
         void LoadLDA();
         void LoadCMVN();
         void LoadIvector();
+        void LoadIvector(const ModelPackage &package);
         template<typename C> void LoadConfig(string file_name, C *opts);
         bool FileExists(string strFilename);
         bool OptionCheck(bool cond, std::string fail_text);
 
         string model_type_str;
+        const ModelPackage *package_;
     };
 }
 
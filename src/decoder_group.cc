@@ -0,0 +1,114 @@
+#include <algorithm>
+
+#include "src/decoder_group.h"
+
+using namespace kaldi;
+
+namespace alex_asr {
+    DecoderGroup::DecoderGroup(std::shared_ptr<ModelBundle> bundle) :
+            bundle_(bundle)
+    {
+        KALDI_ASSERT(bundle_);
+        if(bundle_->Config().model_type != DecoderConfig::NNET2) {
+            KALDI_ERR << "Batched decoding is supported only for nnet2 models.";
+        }
+    }
+
+    DecoderGroup::~DecoderGroup() {
+        for(size_t i = 0; i < decoders_.size(); i++) {
+            decoders_[i]->batched_scoring_ = false;
+        }
+    }
+
+    void DecoderGroup::AddDecoder(Decoder *decoder) {
+        if(decoder->bundle_ != bundle_) {
+            KALDI_ERR << "Only decoders created from the group's model bundle can be added to the group.";
+        }
+        if(std::find(decoders_.begin(), decoders_.end(), decoder) != decoders_.end()) {
+            KALDI_ERR << "The decoder is already in the group.";
+        }
+
+        decoder->batched_scoring_ = true;
+        decoder->Reset();
+        decoders_.push_back(decoder);
+    }
+
+    void DecoderGroup::RemoveDecoder(Decoder *decoder) {
+        std::vector<Decoder *>::iterator it = std::find(decoders_.begin(), decoders_.end(), decoder);
+        if(it == decoders_.end()) {
+            KALDI_ERR << "The decoder is not in the group.";
+        }
+
+        decoders_.erase(it);
+        decoder->batched_scoring_ = false;
+        decoder->Reset();
+    }
+
+    int32 DecoderGroup::Decode(int32 max_frames, std::vector<int32> *num_decoded) {
+        const Nnet2Scorer &scorer = bundle_->Nnet2Scoring();
+
+        // Collect the pending frames of all streams into one input matrix.
+        std::vector<int32> num_pending(decoders_.size(), 0);
+        int32 num_rows = 0;
+        for(size_t i = 0; i < decoders_.size(); i++) {
+            Decoder *decoder = decoders_[i];
+            int32 frame_limit = -1;
+            if(max_frames >= 0)
+                frame_limit = decoder->decoder_->NumFramesDecoded() + max_frames;
+
+            num_pending[i] = decoder->nnet2_batched_->NumFramesPending(frame_limit);
+            if(num_pending[i] > 0)
+                num_rows += scorer.NumInputRows(num_pending[i]);
+        }
+
+        if(num_rows > 0) {
+            Matrix<BaseFloat> input(num_rows, scorer.InputDim(), kUndefined);
+            std::vector<int32> rows;
+            int32 row = 0;
+            for(size_t i = 0; i < decoders_.size(); i++) {
+                if(num_pending[i] == 0)
+                    continue;
+
+                int32 chunk_rows = scorer.NumInputRows(num_pending[i]);
+                SubMatrix<BaseFloat> chunk(input, row, chunk_rows, 0, input.NumCols());
+                decoders_[i]->nnet2_batched_->GetPendingInput(num_pending[i], &chunk);
+                decoders_[i]->nnet2_batched_->GetPendingRows(num_pending[i], row, &rows);
+                row += chunk_rows;
+            }
+
+            // Without subsampling, output row r belongs to input rows starting
+            // at r, so every chunk's log-likelihoods start at the same row as its
+            // input did. With subsampling, only the requested rows are computed
+            // and each chunk's log-likelihoods follow the previous chunk's.
+            Matrix<BaseFloat> loglikes;
+            bool subsampled = scorer.FrameSubsamplingFactor() > 1;
+            if(subsampled)
+                scorer.ComputeRows(input, rows, &loglikes);
+            else
+                scorer.Compute(input, &loglikes);
+
+            row = 0;
+            for(size_t i = 0; i < decoders_.size(); i++) {
+                if(num_pending[i] == 0)
+                    continue;
+
+                decoders_[i]->nnet2_batched_->AcceptLoglikes(loglikes.RowRange(row, num_pending[i]),
+                                                            decoders_[i]->decoder_->NumFramesDecoded());
+                row += subsampled ? num_pending[i] : scorer.NumInputRows(num_pending[i]);
+            }
+        }
+
+        if(num_decoded != NULL)
+            num_decoded->resize(decoders_.size());
+
+        int32 total_decoded = 0;
+        for(size_t i = 0; i < decoders_.size(); i++) {
+            int32 n = decoders_[i]->Decode(max_frames);
+            if(num_decoded != NULL)
+                (*num_decoded)[i] = n;
+            total_decoded += n;
+        }
+
+        return total_decoded;
+    }
+}
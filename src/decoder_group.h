@@ -0,0 +1,43 @@
+#ifndef ALEX_ASR_DECODER_GROUP_H_
+#define ALEX_ASR_DECODER_GROUP_H_
+
+#include <memory>
+#include <vector>
+
+#include "src/decoder.h"
+#include "src/model_bundle.h"
+
+using namespace kaldi;
+
+namespace alex_asr {
+    // Decodes several streams that use the same nnet2 model bundle. The frames
+    // that are pending in all streams are scored together in one forward pass
+    // of the network, and then the search of each stream is advanced.
+    //
+    // The group does not own the decoders; they have to stay alive until they
+    // are removed from the group or the group is destroyed.
+    class DecoderGroup {
+    public:
+        DecoderGroup(std::shared_ptr<ModelBundle> bundle);
+        ~DecoderGroup();
+
+        // Adds a decoder created from the group's bundle. The decoder is reset.
+        void AddDecoder(Decoder *decoder);
+        // Removes a decoder from the group. The decoder is reset.
+        void RemoveDecoder(Decoder *decoder);
+        int32 NumDecoders() const { return decoders_.size(); }
+
+        // Scores pending frames of all decoders in one batch and advances
+        // decoding of each decoder by at most max_frames. If num_decoded is not
+        // NULL, it receives the number of frames decoded by each decoder (in the
+        // order they were added). Returns the total number of decoded frames.
+        int32 Decode(int32 max_frames, std::vector<int32> *num_decoded = NULL);
+    private:
+        std::shared_ptr<ModelBundle> bundle_;
+        std::vector<Decoder *> decoders_;
+
+        KALDI_DISALLOW_COPY_AND_ASSIGN(DecoderGroup);
+    };
+}
+
+#endif  // ALEX_ASR_DECODER_GROUP_H_
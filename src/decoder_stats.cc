@@ -0,0 +1,35 @@
+#include <time.h>
+
+#include "src/decoder_stats.h"
+
+using namespace kaldi;
+
+namespace alex_asr {
+    static double ClockSeconds(clockid_t clock) {
+        struct timespec ts;
+        clock_gettime(clock, &ts);
+        return ts.tv_sec + ts.tv_nsec * 1.0e-9;
+    }
+
+    StageClock::StageClock() :
+            enabled_(false),
+            current_(NULL),
+            last_wall_(0.0),
+            last_cpu_(0.0)
+    { }
+
+    void StageClock::Switch(StageStats *stage) {
+        // The thread CPU clock is a system call, so each clock is read once per switch.
+        double wall = ClockSeconds(CLOCK_MONOTONIC);
+        double cpu = ClockSeconds(CLOCK_THREAD_CPUTIME_ID);
+
+        if(current_ != NULL) {
+            current_->wall_seconds += wall - last_wall_;
+            current_->cpu_seconds += cpu - last_cpu_;
+        }
+
+        current_ = stage;
+        last_wall_ = wall;
+        last_cpu_ = cpu;
+    }
+}
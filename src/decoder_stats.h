@@ -0,0 +1,172 @@
+#ifndef ALEX_ASR_DECODER_STATS_H_
+#define ALEX_ASR_DECODER_STATS_H_
+
+#include "base/kaldi-common.h"
+#include "itf/decodable-itf.h"
+#include "itf/online-feature-itf.h"
+
+using namespace kaldi;
+
+namespace alex_asr {
+    struct StageStats {
+        double wall_seconds;
+        double cpu_seconds;  // CPU time of the calling thread.
+        int64 count;         // How many times the stage was entered.
+
+        StageStats() : wall_seconds(0.0), cpu_seconds(0.0), count(0) { }
+    };
+
+    // Cumulative statistics of a Decoder (over all utterances until ResetStats()).
+    //
+    // Times are exclusive: e.g. features computed while the acoustic model asks
+    // for them count only as "features", not as "likelihoods" or "search".
+    struct DecoderStats {
+        StageStats pcm_conversion;  // Conversion of raw audio in FrameIn.
+        StageStats features;        // The feature pipeline (MFCC, pitch, CMVN, splice, LDA, ivectors).
+        StageStats likelihoods;     // Acoustic model evaluation.
+        StageStats search;          // The rest of AdvanceDecoding.
+        StageStats lattice;         // GetLattice and GetNBest.
+
+        int64 samples;              // Audio samples passed to the feature pipeline.
+        int64 frames_decoded;
+        // Likelihoods requested by the search, i.e. emitting arcs expanded; a
+        // measure of the number of active tokens (which Kaldi does not expose).
+        int64 arcs_expanded;
+        int64 max_frame_arcs_expanded;  // Most arcs expanded in a single frame.
+
+        int64 num_lattices;
+        int64 raw_lattice_states;   // Summed over all lattices.
+        int64 raw_lattice_arcs;
+        int64 lattice_states;       // Of the determinized lattices, summed over all lattices.
+        int64 lattice_arcs;
+
+        DecoderStats() :
+                samples(0),
+                frames_decoded(0),
+                arcs_expanded(0),
+                max_frame_arcs_expanded(0),
+                num_lattices(0),
+                raw_lattice_states(0),
+                raw_lattice_arcs(0),
+                lattice_states(0),
+                lattice_arcs(0)
+        { }
+    };
+
+    // Charges the time between its Switch() calls to the current stage.
+    class StageClock {
+    public:
+        StageClock();
+
+        void SetEnabled(bool enabled) { enabled_ = enabled; }
+        bool Enabled() const { return enabled_; }
+        StageStats *Current() const { return current_; }
+
+        // Charges the time since the previous switch to the current stage and
+        // makes "stage" (which may be NULL) the current one.
+        void Switch(StageStats *stage);
+    private:
+        bool enabled_;
+        StageStats *current_;
+        double last_wall_;
+        double last_cpu_;
+    };
+
+    // Makes "stage" the current stage for its lifetime.
+    class ScopedStage {
+    public:
+        ScopedStage(StageClock *clock, StageStats *stage) :
+                clock_(clock->Enabled() ? clock : NULL),
+                previous_(clock->Current())
+        {
+            if(clock_ != NULL) {
+                clock_->Switch(stage);
+                stage->count++;
+            }
+        }
+
+        ~ScopedStage() {
+            if(clock_ != NULL) {
+                clock_->Switch(previous_);
+            }
+        }
+    private:
+        StageClock *clock_;
+        StageStats *previous_;
+
+        KALDI_DISALLOW_COPY_AND_ASSIGN(ScopedStage);
+    };
+
+    // Forwards to a feature and charges the computation of frames to the features stage.
+    class TimedFeature : public OnlineFeatureInterface {
+    public:
+        TimedFeature(OnlineFeatureInterface *feature, StageClock *clock, DecoderStats *stats) :
+                feature_(feature), clock_(clock), stats_(stats) { }
+
+        virtual int32 Dim() const { return feature_->Dim(); }
+        virtual bool IsLastFrame(int32 frame) const { return feature_->IsLastFrame(frame); }
+        virtual int32 NumFramesReady() const { return feature_->NumFramesReady(); }
+
+        virtual void GetFrame(int32 frame, VectorBase<BaseFloat> *feat) {
+            ScopedStage stage(clock_, &stats_->features);
+            feature_->GetFrame(frame, feat);
+        }
+
+        void Reset(OnlineFeatureInterface *feature) { feature_ = feature; }
+    private:
+        OnlineFeatureInterface *feature_;
+        StageClock *clock_;
+        DecoderStats *stats_;
+    };
+
+    // Forwards to a decodable, counts the likelihood requests and charges the
+    // acoustic model evaluation to the likelihoods stage. Only the first request
+    // of each frame is timed: Kaldi's nnet2 decodables compute all likelihoods
+    // of a frame (or a chunk of frames) then, and timing every request would
+    // cost more than the lookups themselves. With GMM models, which evaluate
+    // each pdf on demand, most of the model evaluation is counted as search.
+    class TimedDecodable : public DecodableInterface {
+    public:
+        TimedDecodable(DecodableInterface *decodable, StageClock *clock, DecoderStats *stats) :
+                decodable_(decodable), clock_(clock), stats_(stats), frame_(-1), frame_arcs_(0) { }
+
+        virtual BaseFloat LogLikelihood(int32 frame, int32 index) {
+            stats_->arcs_expanded++;
+            if(frame == frame_) {
+                frame_arcs_++;
+                return decodable_->LogLikelihood(frame, index);
+            }
+
+            UpdateMaxFrameArcs();
+            frame_ = frame;
+            frame_arcs_ = 1;
+            ScopedStage stage(clock_, &stats_->likelihoods);
+            return decodable_->LogLikelihood(frame, index);
+        }
+
+        virtual bool IsLastFrame(int32 frame) const { return decodable_->IsLastFrame(frame); }
+        virtual int32 NumFramesReady() const { return decodable_->NumFramesReady(); }
+        virtual int32 NumIndices() const { return decodable_->NumIndices(); }
+
+        // Accounts the arcs of the frame decoded last in max_frame_arcs_expanded.
+        void UpdateMaxFrameArcs() {
+            if(frame_arcs_ > stats_->max_frame_arcs_expanded) {
+                stats_->max_frame_arcs_expanded = frame_arcs_;
+            }
+        }
+
+        void Reset(DecodableInterface *decodable) {
+            decodable_ = decodable;
+            frame_ = -1;
+            frame_arcs_ = 0;
+        }
+    private:
+        DecodableInterface *decodable_;
+        StageClock *clock_;
+        DecoderStats *stats_;
+        int32 frame_;
+        int32 frame_arcs_;
+    };
+}
+
+#endif  // ALEX_ASR_DECODER_STATS_H_
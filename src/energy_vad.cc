@@ -0,0 +1,138 @@
+#include <algorithm>
+#include <cmath>
+
+#include "src/energy_vad.h"
+
+using namespace kaldi;
+
+namespace alex_asr {
+    // The noise floor rises by at most this much per frame (5 dB/s at 10 ms frames).
+    static const BaseFloat kNoiseFloorRiseDb = 0.05;
+    // Frames quieter than this (about -60 dBFS for 16-bit audio) are never speech,
+    // so that the floor of digital silence does not make every noise look like speech.
+    static const BaseFloat kMinSpeechDb = 30.0;
+
+    EnergyVad::EnergyVad(BaseFloat samp_freq, BaseFloat frame_ms, BaseFloat threshold_db,
+                         BaseFloat max_silence_ms) :
+            frame_length_(static_cast<int32>(samp_freq * frame_ms * 1.0e-03)),
+            threshold_db_(threshold_db),
+            half_silence_(static_cast<int32>(samp_freq * max_silence_ms * 0.5e-03))
+    {
+        KALDI_ASSERT(frame_length_ > 0);
+        Reset();
+    }
+
+    void EnergyVad::Reset() {
+        frame_.clear();
+        noise_floor_db_ = 0.0;
+        have_noise_floor_ = false;
+        // Leading silence is shortened like any other: only its end is kept.
+        silence_run_ = half_silence_;
+        held_.clear();
+        num_dropped_ = 0;
+        num_out_ = 0;
+        gaps_.clear();
+        total_dropped_ = 0;
+    }
+
+    void EnergyVad::AcceptWaveform(const VectorBase<BaseFloat> &in, std::vector<BaseFloat> *out) {
+        const BaseFloat *data = in.Data();
+        int32 n = in.Dim(), i = 0;
+
+        if(!frame_.empty()) {
+            int32 missing = std::min<int32>(frame_length_ - static_cast<int32>(frame_.size()), n);
+            frame_.insert(frame_.end(), data, data + missing);
+            i = missing;
+            if(static_cast<int32>(frame_.size()) < frame_length_)
+                return;
+            ProcessFrame(&frame_[0], frame_length_, out);
+            frame_.clear();
+        }
+
+        for(; i + frame_length_ <= n; i += frame_length_) {
+            ProcessFrame(data + i, frame_length_, out);
+        }
+        frame_.insert(frame_.end(), data + i, data + n);
+    }
+
+    void EnergyVad::InputFinished(std::vector<BaseFloat> *out) {
+        if(!frame_.empty()) {
+            ProcessFrame(&frame_[0], frame_.size(), out);
+            frame_.clear();
+        }
+    }
+
+    bool EnergyVad::IsSpeech(const BaseFloat *samples, int32 num_samples) {
+        double sum = 0.0;
+        for(int32 i = 0; i < num_samples; i++) {
+            sum += samples[i] * samples[i];
+        }
+        BaseFloat energy_db = 10.0 * std::log10(sum / num_samples + 1.0e-10);
+
+        if(!have_noise_floor_ || energy_db < noise_floor_db_) {
+            noise_floor_db_ = energy_db;
+            have_noise_floor_ = true;
+        } else {
+            noise_floor_db_ = std::min(energy_db, noise_floor_db_ + kNoiseFloorRiseDb);
+        }
+
+        return energy_db > kMinSpeechDb && energy_db > noise_floor_db_ + threshold_db_;
+    }
+
+    void EnergyVad::ProcessFrame(const BaseFloat *samples, int32 num_samples, std::vector<BaseFloat> *out) {
+        if(IsSpeech(samples, num_samples)) {
+            if(num_dropped_ > 0) {
+                total_dropped_ += num_dropped_;
+                gaps_.push_back(std::make_pair(num_out_, total_dropped_));
+                num_dropped_ = 0;
+            }
+            out->insert(out->end(), held_.begin(), held_.end());
+            num_out_ += held_.size();
+            held_.clear();
+
+            out->insert(out->end(), samples, samples + num_samples);
+            num_out_ += num_samples;
+            silence_run_ = 0;
+            return;
+        }
+
+        // Silence: pass on the beginning, hold the end and drop what does not fit.
+        int32 i = 0;
+        if(silence_run_ < half_silence_) {
+            int32 num_passed = std::min<int64>(num_samples, half_silence_ - silence_run_);
+            out->insert(out->end(), samples, samples + num_passed);
+            num_out_ += num_passed;
+            i = num_passed;
+        }
+        held_.insert(held_.end(), samples + i, samples + num_samples);
+        silence_run_ += num_samples;
+
+        if(static_cast<int64>(held_.size()) > half_silence_) {
+            int64 excess = static_cast<int64>(held_.size()) - half_silence_;
+            held_.erase(held_.begin(), held_.begin() + excess);
+            num_dropped_ += excess;
+        }
+    }
+
+    int64 EnergyVad::ToOriginalSample(int64 sample) const {
+        // The last gap at or before the sample.
+        std::vector<std::pair<int64, int64> >::const_iterator it =
+                std::upper_bound(gaps_.begin(), gaps_.end(), std::make_pair(sample, total_dropped_ + 1));
+        if(it == gaps_.begin())
+            return sample;
+        return sample + (it - 1)->second;
+    }
+
+    void EnergyVad::ForgetBefore(int64 sample) {
+        // The last gap at or before the sample still gives the offset of the samples after it.
+        size_t n = 0;
+        while(n + 1 < gaps_.size() && gaps_[n + 1].first <= sample) {
+            n++;
+        }
+        gaps_.erase(gaps_.begin(), gaps_.begin() + n);
+    }
+
+    int64 EnergyVad::NumSamplesPending() const {
+        return held_.size() + num_dropped_ + frame_.size();
+    }
+}
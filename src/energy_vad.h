@@ -0,0 +1,73 @@
+#ifndef ALEX_ASR_ENERGY_VAD_H_
+#define ALEX_ASR_ENERGY_VAD_H_
+
+#include <deque>
+#include <utility>
+#include <vector>
+
+#include "base/kaldi-common.h"
+#include "matrix/matrix-lib.h"
+
+using namespace kaldi;
+
+namespace alex_asr {
+    // Energy-based voice activity detection in front of the feature pipeline
+    // (--vad). It shortens every non-speech region to at most
+    // --vad_max_silence_ms, so long silences cost neither features nor the
+    // acoustic model nor the search.
+    //
+    // A frame is speech if its energy is --vad_threshold_db over the noise
+    // floor, which follows the quietest frames (down at once, up slowly). Of a
+    // silence, the first half of the kept length is passed on right away, so
+    // the decoder sees the end of speech without delay; the last half is held
+    // back and passed on when speech starts again, so the onset of speech keeps
+    // its padding. Whatever is in between is dropped.
+    //
+    // Positions in the audio that was passed on are mapped back to the
+    // original audio with ToOriginalSample().
+    class EnergyVad {
+    public:
+        EnergyVad(BaseFloat samp_freq, BaseFloat frame_ms, BaseFloat threshold_db,
+                  BaseFloat max_silence_ms);
+
+        void Reset();
+
+        // Appends to "out" the samples of "in" that are passed on.
+        void AcceptWaveform(const VectorBase<BaseFloat> &in, std::vector<BaseFloat> *out);
+
+        // Decides the incomplete last frame; its samples may be appended to "out".
+        void InputFinished(std::vector<BaseFloat> *out);
+
+        // The position in the original audio of the sample that was passed on at "sample".
+        int64 ToOriginalSample(int64 sample) const;
+
+        // Forgets what is needed only to map samples before "sample".
+        void ForgetBefore(int64 sample);
+
+        // Samples of the current silence that are held back or were dropped so
+        // far, plus the incomplete frame; 0 during speech.
+        int64 NumSamplesPending() const;
+    private:
+        int32 frame_length_;
+        BaseFloat threshold_db_;
+        int32 half_silence_;  // Samples of silence passed on after speech, and held before it.
+
+        std::vector<BaseFloat> frame_;  // The incomplete frame.
+        BaseFloat noise_floor_db_;
+        bool have_noise_floor_;
+        int64 silence_run_;             // Samples since the last speech frame.
+        std::deque<BaseFloat> held_;    // The end of the current silence.
+        int64 num_dropped_;             // Samples of the current silence that were dropped.
+
+        int64 num_out_;
+        // (Position in the output, samples dropped before it in total) for every
+        // place where audio was dropped, in order.
+        std::vector<std::pair<int64, int64> > gaps_;
+        int64 total_dropped_;
+
+        void ProcessFrame(const BaseFloat *samples, int32 num_samples, std::vector<BaseFloat> *out);
+        bool IsSpeech(const BaseFloat *samples, int32 num_samples);
+    };
+}
+
+#endif  // ALEX_ASR_ENERGY_VAD_H_
@@ -1,9 +1,99 @@
+#include <algorithm>
+#include <sstream>
+
 #include "feature_pipeline.h"
 
 using namespace kaldi;
 
 namespace alex_asr {
-    FeaturePipeline::FeaturePipeline(DecoderConfig &config) :
+    FeatureAdaptationState::FeatureAdaptationState(const DecoderConfig &config) :
+        cmvn(NULL),
+        ivector(NULL)
+    {
+        if (config.use_cmvn) {
+            cmvn = new OnlineCmvnState(*config.cmvn_mat);
+        }
+        if (config.use_ivectors) {
+            ivector = new OnlineIvectorExtractorAdaptationState(*config.ivector_extraction_info);
+        }
+    }
+
+    FeatureAdaptationState::~FeatureAdaptationState() {
+        delete cmvn;
+        delete ivector;
+    }
+
+    void FeatureAdaptationState::CopyFrom(const FeatureAdaptationState &other) {
+        KALDI_ASSERT((cmvn == NULL) == (other.cmvn == NULL) && (ivector == NULL) == (other.ivector == NULL));
+        if (cmvn) {
+            *cmvn = *other.cmvn;
+        }
+        if (ivector) {
+            delete ivector;
+            ivector = new OnlineIvectorExtractorAdaptationState(*other.ivector);
+        }
+    }
+
+    void FeatureAdaptationState::Write(std::ostream &os, bool binary) const {
+        WriteToken(os, binary, "<FeatureAdaptationState>");
+        WriteToken(os, binary, "<Cmvn>");
+        WriteBasicType(os, binary, cmvn != NULL);
+        if (cmvn) {
+            cmvn->Write(os, binary);
+        }
+        WriteToken(os, binary, "<Ivector>");
+        WriteBasicType(os, binary, ivector != NULL);
+        if (ivector) {
+            ivector->Write(os, binary);
+        }
+        WriteToken(os, binary, "</FeatureAdaptationState>");
+    }
+
+    void FeatureAdaptationState::Read(std::istream &is, bool binary) {
+        bool has_cmvn, has_ivector;
+        ExpectToken(is, binary, "<FeatureAdaptationState>");
+        ExpectToken(is, binary, "<Cmvn>");
+        ReadBasicType(is, binary, &has_cmvn);
+        if (has_cmvn != (cmvn != NULL)) {
+            KALDI_ERR << "The adaptation state does not match the model: CMVN is "
+                      << (has_cmvn ? "" : "not ") << "in the state but the model "
+                      << (cmvn ? "uses" : "does not use") << " it.";
+        }
+        if (cmvn) {
+            int32 dim = cmvn->global_cmvn_stats.NumCols();
+            cmvn->Read(is, binary);
+            if (cmvn->global_cmvn_stats.NumCols() != dim)
+                KALDI_ERR << "The adaptation state does not match the model: wrong CMVN dimension.";
+        }
+
+        ExpectToken(is, binary, "<Ivector>");
+        ReadBasicType(is, binary, &has_ivector);
+        if (has_ivector != (ivector != NULL)) {
+            KALDI_ERR << "The adaptation state does not match the model: ivectors are "
+                      << (has_ivector ? "" : "not ") << "in the state but the model "
+                      << (ivector ? "uses" : "does not use") << " them.";
+        }
+        if (ivector) {
+            int32 dim = ivector->ivector_stats.IvectorDim();
+            ivector->Read(is, binary);
+            if (ivector->ivector_stats.IvectorDim() != dim)
+                KALDI_ERR << "The adaptation state does not match the model: wrong ivector dimension.";
+        }
+        ExpectToken(is, binary, "</FeatureAdaptationState>");
+    }
+
+    void FeatureAdaptationState::WriteToString(std::string *data) const {
+        std::ostringstream os;
+        Write(os, true);
+        *data = os.str();
+    }
+
+    void FeatureAdaptationState::ReadFromString(const std::string &data) {
+        std::istringstream is(data);
+        Read(is, true);
+    }
+
+    FeaturePipeline::FeaturePipeline(const DecoderConfig &config) :
         mfcc_(NULL),
         cmvn_(NULL),
         cmvn_state_(NULL),
@@ -93,5 +183,29 @@ namespace alex_asr {
     OnlineIvectorFeature *FeaturePipeline::GetIvectorFeature() {
         return ivector_;
     }
+
+    void FeaturePipeline::GetAdaptationState(int32 num_frames, FeatureAdaptationState *state) {
+        if (cmvn_) {
+            num_frames = std::min(num_frames, cmvn_->NumFramesReady());
+        }
+        if (cmvn_ && num_frames > 0) {
+            cmvn_->GetState(num_frames - 1, state->cmvn);
+        } else if (cmvn_) {
+            *state->cmvn = *cmvn_state_;  // The state it started with.
+        }
+        if (ivector_) {
+            ivector_->GetAdaptationState(state->ivector);
+        }
+    }
+
+    void FeaturePipeline::SetAdaptationState(const FeatureAdaptationState &state) {
+        if (cmvn_) {
+            *cmvn_state_ = *state.cmvn;
+            cmvn_->SetState(*state.cmvn);
+        }
+        if (ivector_) {
+            ivector_->SetAdaptationState(*state.ivector);
+        }
+    }
 }
 
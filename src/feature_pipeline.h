@@ -6,15 +6,42 @@
 using namespace kaldi;
 
 namespace alex_asr {
+    // What the feature pipeline of a stream has learned about the speaker and
+    // the channel: the CMVN statistics and the ivector adaptation state. Members
+    // are NULL if the model does not use them.
+    class FeatureAdaptationState {
+    public:
+        FeatureAdaptationState(const DecoderConfig &config);
+        ~FeatureAdaptationState();
+
+        // Both states must be of the same model.
+        void CopyFrom(const FeatureAdaptationState &other);
+
+        // Reading fails if the state is not of a model with the same features.
+        void Write(std::ostream &os, bool binary) const;
+        void Read(std::istream &is, bool binary);
+        void WriteToString(std::string *data) const;  // In the binary format.
+        void ReadFromString(const std::string &data);
+
+        OnlineCmvnState *cmvn;
+        OnlineIvectorExtractorAdaptationState *ivector;
+    private:
+        KALDI_DISALLOW_COPY_AND_ASSIGN(FeatureAdaptationState);
+    };
+
     class FeaturePipeline {
     public:
-        FeaturePipeline(DecoderConfig & config);
+        FeaturePipeline(const DecoderConfig &config);
         ~FeaturePipeline();
         OnlineFeatureInterface *GetFeature();
         void AcceptWaveform(BaseFloat sampling_rate,
                             const VectorBase<BaseFloat> &waveform);
         void InputFinished();
         OnlineIvectorFeature* GetIvectorFeature();
+        // The adaptation state after the first num_frames frames.
+        void GetAdaptationState(int32 num_frames, FeatureAdaptationState *state);
+        // Must be called before any features are computed.
+        void SetAdaptationState(const FeatureAdaptationState &state);
     private:
         OnlineMfcc *mfcc_;
         OnlineCmvn *cmvn_;
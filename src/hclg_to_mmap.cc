@@ -0,0 +1,55 @@
+#include <fstream>
+
+#include "base/kaldi-common.h"
+#include "util/common-utils.h"
+#include "online2/onlinebin-util.h"
+
+#include "src/mapped_fst.h"
+
+using namespace kaldi;
+using namespace alex_asr;
+
+int main(int argc, char *argv[]) {
+    try {
+        const char *usage =
+                "Convert a decoding graph (HCLG) to the memory mappable format that is loaded\n"
+                "when alex_asr.conf sets --use_hclg_mmap=true.\n"
+                "\n"
+                "Usage: hclg_to_mmap [options] <hclg-rxfilename> <mapped-hclg-filename>\n"
+                " e.g.: hclg_to_mmap HCLG.fst HCLG.mmap\n";
+
+        ParseOptions po(usage);
+        po.Read(argc, argv);
+
+        if (po.NumArgs() != 2) {
+            po.PrintUsage();
+            return 1;
+        }
+
+        std::string hclg_rxfilename = po.GetArg(1),
+                mapped_filename = po.GetArg(2);
+
+        fst::Fst<fst::StdArc> *hclg = ReadDecodeGraph(hclg_rxfilename);
+
+        const fst::ExpandedFst<fst::StdArc> *expanded = dynamic_cast<const fst::ExpandedFst<fst::StdArc> *>(hclg);
+        fst::VectorFst<fst::StdArc> *converted = NULL;
+        if (expanded == NULL) {
+            expanded = converted = new fst::VectorFst<fst::StdArc>(*hclg);
+        }
+
+        std::ofstream os(mapped_filename.c_str(), std::ios::out | std::ios::binary);
+        if (!os.is_open() || !MappedStdFst::Write(*expanded, os)) {
+            KALDI_ERR << "Error writing mapped HCLG to " << mapped_filename;
+        }
+        os.close();
+
+        KALDI_LOG << "Wrote mapped HCLG with " << expanded->NumStates() << " states to " << mapped_filename;
+
+        delete converted;
+        delete hclg;
+        return 0;
+    } catch(const std::exception &e) {
+        std::cerr << e.what();
+        return -1;
+    }
+}
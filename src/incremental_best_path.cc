@@ -0,0 +1,189 @@
+#include "src/incremental_best_path.h"
+
+#include <algorithm>
+#include <limits>
+#include <set>
+
+#include "fstext/fstext-lib.h"
+#include "lat/lattice-functions.h"
+
+using namespace kaldi;
+
+namespace alex_asr {
+    IncrementalBestPath::IncrementalBestPath() :
+            converged_frame_(0),
+            converged_words_(0)
+    { }
+
+    void IncrementalBestPath::Reset() {
+        steps_.clear();
+        step_index_.clear();
+        words_.clear();
+        converged_frame_ = 0;
+        converged_words_ = 0;
+    }
+
+    bool IncrementalBestPath::Update(const LatticeFasterOnlineDecoder &decoder, bool use_final_probs,
+                                     int32 *num_kept, std::vector<int32> *new_words, BaseFloat *cost,
+                                     int32 *num_stable) {
+        struct NewStep {
+            const void *tok;
+            int32 frame;
+            int32 olabel;
+            BaseFloat cost;  // Cost of the arc into the token.
+        };
+
+        BaseFloat final_cost = 0.0;
+        LatticeFasterOnlineDecoder::BestPathIterator iter = decoder.BestPathEnd(use_final_probs,
+                                                                                &final_cost);
+
+        // Trace back until we reach the previous path.
+        std::vector<NewStep> new_steps;
+        int32 match = -1;
+        while(!iter.Done()) {
+            std::unordered_map<const void *, int32>::const_iterator it = step_index_.find(iter.tok);
+            if(it != step_index_.end() && steps_[it->second].frame == iter.frame) {
+                match = it->second;
+                break;
+            }
+
+            NewStep step;
+            step.tok = iter.tok;
+            step.frame = iter.frame;
+
+            LatticeArc arc;
+            iter = decoder.TraceBackBestPath(iter, &arc);
+            step.olabel = arc.olabel;
+            step.cost = arc.weight.Value1() + arc.weight.Value2();
+            new_steps.push_back(step);
+        }
+
+        if(match < 0 && new_steps.empty()) {
+            Reset();
+            *num_kept = 0;
+            new_words->clear();
+            *cost = 0.0;
+            if(num_stable != NULL) {
+                *num_stable = 0;
+            }
+            return false;
+        }
+
+        // Drop the part of the previous path after the common token.
+        for(size_t i = match + 1; i < steps_.size(); i++) {
+            step_index_.erase(steps_[i].tok);
+        }
+        steps_.resize(match + 1);
+
+        int32 num_words = (match >= 0 ? steps_[match].num_words : 0);
+        double path_cost = (match >= 0 ? steps_[match].cost : 0.0);
+        size_t kept = num_words;
+
+        std::vector<int32> old_words(words_.begin() + kept, words_.end());
+        words_.resize(kept);
+
+        for(int32 i = static_cast<int32>(new_steps.size()) - 1; i >= 0; i--) {
+            const NewStep &new_step = new_steps[i];
+            path_cost += new_step.cost;
+            if(new_step.olabel != 0) {
+                words_.push_back(new_step.olabel);
+                num_words++;
+            }
+
+            Step step;
+            step.tok = new_step.tok;
+            step.frame = new_step.frame;
+            step.num_words = num_words;
+            step.cost = path_cost;
+            step_index_[step.tok] = steps_.size();
+            steps_.push_back(step);
+        }
+
+        // Words that came out the same on the new part of the path are kept as well.
+        size_t same = 0;
+        while(same < old_words.size() && kept + same < words_.size()
+              && old_words[same] == words_[kept + same]) {
+            same++;
+        }
+
+        *num_kept = kept + same;
+        new_words->assign(words_.begin() + *num_kept, words_.end());
+        *cost = path_cost + final_cost;
+
+        if(num_stable != NULL) {
+            // Without final probabilities, all tokens of the last frame are final.
+            Lattice raw_lat;
+            decoder.GetRawLattice(&raw_lat, false);
+            *num_stable = NumStableWords(&raw_lat);
+        }
+        return true;
+    }
+
+    int32 IncrementalBestPath::NumStableWords(Lattice *raw_lat) {
+        typedef Lattice::StateId StateId;
+
+        if(raw_lat->Start() == fst::kNoStateId)
+            return 0;
+        TopSortLatticeIfNeeded(raw_lat);
+
+        std::vector<int32> state_times;
+        int32 num_frames = LatticeStateTimes(*raw_lat, &state_times);
+
+        // The traceback of a token: its best predecessor and the word on the arc from it.
+        StateId num_states = raw_lat->NumStates();
+        std::vector<double> best_cost(num_states, std::numeric_limits<double>::infinity());
+        std::vector<std::pair<StateId, int32> > best_prev(num_states, std::make_pair(fst::kNoStateId, 0));
+        best_cost[raw_lat->Start()] = 0.0;
+        for(StateId s = raw_lat->Start(); s < num_states; s++) {
+            if(best_cost[s] == std::numeric_limits<double>::infinity())
+                continue;
+            for(fst::ArcIterator<Lattice> aiter(*raw_lat, s); !aiter.Done(); aiter.Next()) {
+                const LatticeArc &arc = aiter.Value();
+                double arc_cost = best_cost[s] + arc.weight.Value1() + arc.weight.Value2();
+                if(arc_cost < best_cost[arc.nextstate]) {
+                    best_cost[arc.nextstate] = arc_cost;
+                    best_prev[arc.nextstate] = std::make_pair(s, arc.olabel);
+                }
+            }
+        }
+
+        // Predecessors come first in topological order, so replacing the last
+        // state of the set by its predecessor until one state is left walks
+        // the tracebacks back to where they meet.
+        std::set<StateId> frontier;
+        for(StateId s = 0; s < num_states; s++) {
+            if(state_times[s] == num_frames && best_cost[s] != std::numeric_limits<double>::infinity()) {
+                frontier.insert(s);
+            }
+        }
+        while(frontier.size() > 1) {
+            StateId s = *frontier.rbegin();
+            frontier.erase(s);
+            frontier.insert(best_prev[s].first);
+        }
+        if(frontier.empty())
+            return 0;
+        StateId meet = *frontier.begin();
+
+        // Only the words after the previous meeting point are counted again.
+        if(state_times[meet] < converged_frame_) {
+            converged_frame_ = 0;
+            converged_words_ = 0;
+        }
+        int32 num_words = converged_words_, words_at_meet_frame = 0;
+        for(StateId s = meet; best_prev[s].first != fst::kNoStateId && state_times[s] >= converged_frame_;
+                s = best_prev[s].first) {
+            if(best_prev[s].second != 0) {
+                num_words++;
+                if(state_times[s] >= state_times[meet]) {
+                    words_at_meet_frame++;
+                }
+            }
+        }
+        converged_frame_ = state_times[meet];
+        converged_words_ = num_words - words_at_meet_frame;
+
+        // On ties the best path of the decoder may differ from the one found here.
+        return std::min<int32>(num_words, words_.size());
+    }
+}
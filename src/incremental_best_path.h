@@ -0,0 +1,81 @@
+#ifndef ALEX_ASR_INCREMENTAL_BEST_PATH_H_
+#define ALEX_ASR_INCREMENTAL_BEST_PATH_H_
+
+#include <unordered_map>
+#include <vector>
+
+#include "base/kaldi-common.h"
+#include "decoder/lattice-faster-online-decoder.h"
+#include "lat/kaldi-lattice.h"
+
+using namespace kaldi;
+
+namespace alex_asr {
+    // Keeps the best path traceback of the current utterance between calls.
+    //
+    // The best path is traced back from its end only until it reaches a token
+    // of the previous traceback; from there on the two paths share their
+    // ancestry, so the words and the cost up to that token are reused. Polling
+    // after every decoded chunk therefore costs time proportional to the part
+    // of the path that changed, not to the length of the utterance.
+    //
+    // Tokens are identified by their address and frame. Tokens of a frame are
+    // only created while that frame is decoded, so an address that the decoder
+    // reuses after pruning never matches a cached token at the same frame.
+    //
+    // The words before the point where the tracebacks of all active tokens
+    // meet can no longer change. Kaldi's decoder does not expose its tokens,
+    // so the tracebacks are rebuilt from the raw lattice, which has a state
+    // per token: the traceback of a token is its best path in the lattice,
+    // and the point where those of all states of the last frame meet is
+    // found by walking back from them. The walk and the counting of the words
+    // before that point stop at the point found by the previous call, as it
+    // lies on all later tracebacks. Getting the raw lattice from Kaldi and
+    // finding the best predecessor of each of its states are still a pass
+    // over the whole utterance, so this is only done on request.
+    //
+    // The count is conservative: the raw lattice keeps every token within the
+    // lattice beam until the decoder prunes it, including tokens that the
+    // search will drop, so the tracebacks meet later than those of the tokens
+    // that are still competing.
+    class IncrementalBestPath {
+    public:
+        IncrementalBestPath();
+
+        // Must be called whenever the decoder starts a new utterance.
+        void Reset();
+
+        // Updates the best path. The first num_kept words of the previous best
+        // path are unchanged; new_words are the words that follow them. If
+        // num_stable is not NULL, it receives the number of leading words of
+        // the best path that all active tokens agree on; Kaldi allows that
+        // only before FinalizeDecoding(). Returns false if the decoder has no path.
+        bool Update(const LatticeFasterOnlineDecoder &decoder, bool use_final_probs,
+                    int32 *num_kept, std::vector<int32> *new_words, BaseFloat *cost,
+                    int32 *num_stable = NULL);
+
+        const std::vector<int32> &Words() const { return words_; }
+    private:
+        struct Step {
+            const void *tok;
+            int32 frame;
+            int32 num_words;  // Words on the path up to and including this token.
+            double cost;      // Cost of the path up to this token.
+        };
+
+        // Number of leading words of words_ before the point where the
+        // tracebacks of the last frame of raw_lat meet; updates converged_frame_.
+        int32 NumStableWords(Lattice *raw_lat);
+
+        std::vector<Step> steps_;  // From the start token to the end of the best path.
+        std::unordered_map<const void *, int32> step_index_;
+        std::vector<int32> words_;
+
+        // Frame where the tracebacks met at the previous NumStableWords() call,
+        // and the number of words of the traceback before that frame.
+        int32 converged_frame_;
+        int32 converged_words_;
+    };
+}
+
+#endif  // ALEX_ASR_INCREMENTAL_BEST_PATH_H_
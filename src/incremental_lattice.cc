@@ -0,0 +1,223 @@
+#include "src/incremental_lattice.h"
+
+#include <algorithm>
+
+#include "fstext/fstext-lib.h"
+#include "lat/lattice-functions.h"
+#include "lat/minimize-lattice.h"
+#include "lat/push-lattice.h"
+
+using namespace kaldi;
+
+namespace alex_asr {
+    typedef CompactLattice::StateId CompactStateId;
+
+    // Returns the only final state of clat, or kNoStateId if there is not
+    // exactly one or it has outgoing arcs (then nothing can be spliced onto it
+    // without making the lattice non-deterministic).
+    static CompactStateId SingleFinalState(const CompactLattice &clat) {
+        CompactStateId final_state = fst::kNoStateId;
+        for(CompactStateId s = 0; s < clat.NumStates(); s++) {
+            if(clat.Final(s) == CompactLatticeWeight::Zero())
+                continue;
+            if(final_state != fst::kNoStateId || clat.NumArcs(s) != 0)
+                return fst::kNoStateId;
+            final_state = s;
+        }
+        return final_state;
+    }
+
+    // Appends src to dst, merging the start state of src into dst_final.
+    static void Splice(const CompactLattice &src, CompactStateId dst_final, CompactLattice *dst,
+                       std::vector<CompactStateId> *state_map) {
+        CompactLatticeWeight final_weight = dst->Final(dst_final);
+        dst->SetFinal(dst_final, CompactLatticeWeight::Zero());
+
+        if(src.Start() == fst::kNoStateId) {
+            // Nothing survived the pruning of src, so no path survives.
+            dst->DeleteStates();
+            state_map->clear();
+            return;
+        }
+
+        state_map->resize(src.NumStates());
+        for(CompactStateId s = 0; s < src.NumStates(); s++) {
+            (*state_map)[s] = (s == src.Start() ? dst_final : dst->AddState());
+        }
+
+        for(CompactStateId s = 0; s < src.NumStates(); s++) {
+            for(fst::ArcIterator<CompactLattice> aiter(src, s); !aiter.Done(); aiter.Next()) {
+                CompactLatticeArc arc = aiter.Value();
+                arc.nextstate = (*state_map)[arc.nextstate];
+                if(s == src.Start()) {
+                    arc.weight = fst::Times(final_weight, arc.weight);
+                }
+                dst->AddArc((*state_map)[s], arc);
+            }
+
+            CompactLatticeWeight weight = src.Final(s);
+            if(weight != CompactLatticeWeight::Zero()) {
+                if(s == src.Start()) {
+                    weight = fst::Times(final_weight, weight);
+                }
+                dst->SetFinal((*state_map)[s], weight);
+            }
+        }
+    }
+
+    IncrementalDeterminizer::IncrementalDeterminizer(const TransitionModel &trans_model,
+                                                     BaseFloat lattice_beam,
+                                                     const fst::DeterminizeLatticePhonePrunedOptions &opts) :
+            trans_model_(trans_model),
+            lattice_beam_(lattice_beam),
+            opts_(opts),
+            prefix_frames_(0),
+            prefix_final_(fst::kNoStateId),
+            tried_frame_(0)
+    { }
+
+    void IncrementalDeterminizer::Reset() {
+        prefix_.DeleteStates();
+        prefix_frames_ = 0;
+        prefix_final_ = fst::kNoStateId;
+        tried_frame_ = 0;
+    }
+
+    bool IncrementalDeterminizer::Determinize(Lattice *raw_lat, CompactLattice *clat) {
+        clat->DeleteStates();
+
+        // Drop the states that do not lead to the end, so that bottlenecks are easier to find.
+        fst::Connect(raw_lat);
+        if(raw_lat->Start() == fst::kNoStateId) {
+            KALDI_WARN << "The raw lattice is empty.";
+            return false;
+        }
+        TopSortLatticeIfNeeded(raw_lat);
+
+        std::vector<int32> state_times;
+        int32 num_frames = LatticeStateTimes(*raw_lat, &state_times);
+
+        // The number of states at each frame, and the last of them.
+        std::vector<int32> frame_num_states(num_frames + 1, 0);
+        std::vector<StateId> frame_state(num_frames + 1, fst::kNoStateId);
+        for(StateId s = 0; s < raw_lat->NumStates(); s++) {
+            frame_num_states[state_times[s]]++;
+            frame_state[state_times[s]] = s;
+        }
+
+        if(prefix_frames_ > 0 &&
+                (prefix_frames_ >= num_frames || frame_num_states[prefix_frames_] != 1)) {
+            KALDI_WARN << "The cached lattice does not match the raw lattice; was Reset() called?";
+            Reset();
+        }
+
+        StateId start_state = (prefix_frames_ > 0 ? frame_state[prefix_frames_] : raw_lat->Start());
+        int32 start_frame = prefix_frames_;
+
+        // Extend the cached prefix up to the latest new bottleneck.
+        for(int32 t = num_frames - 1; t > std::max(start_frame, tried_frame_); t--) {
+            if(frame_num_states[t] != 1)
+                continue;
+
+            Lattice segment;
+            CompactLattice det_segment;
+            ExtractSegment(*raw_lat, state_times, start_state, start_frame, frame_state[t], t, &segment);
+            tried_frame_ = t;
+            if(!DeterminizeSegment(&segment, &det_segment))
+                break;
+
+            // All paths of the segment end in the same raw state, so once the
+            // strings and weights are pushed towards the start, the final
+            // states are equivalent and minimization merges them. With
+            // --minimize the determinization has done this already.
+            if(!opts_.minimize) {
+                PushCompactLatticeStrings(&det_segment);
+                PushCompactLatticeWeights(&det_segment);
+                MinimizeCompactLattice(&det_segment);
+                TopSortCompactLatticeIfNeeded(&det_segment);
+            }
+
+            CompactStateId segment_final = SingleFinalState(det_segment);
+            if(segment_final == fst::kNoStateId) {
+                KALDI_VLOG(3) << "Could not cache the determinized lattice up to frame " << t;
+                break;
+            }
+
+            if(prefix_frames_ == 0) {
+                prefix_ = det_segment;
+                prefix_final_ = segment_final;
+            } else {
+                std::vector<CompactStateId> state_map;
+                Splice(det_segment, prefix_final_, &prefix_, &state_map);
+                prefix_final_ = state_map[segment_final];
+            }
+            prefix_frames_ = start_frame = t;
+            start_state = frame_state[t];
+            KALDI_VLOG(3) << "Cached determinized lattice up to frame " << t;
+            break;
+        }
+
+        // The rest is determinized on every call.
+        Lattice tail;
+        CompactLattice det_tail;
+        ExtractSegment(*raw_lat, state_times, start_state, start_frame, fst::kNoStateId, num_frames,
+                       &tail);
+        bool ok = DeterminizeSegment(&tail, &det_tail);
+
+        if(prefix_frames_ == 0) {
+            *clat = det_tail;
+        } else {
+            std::vector<CompactStateId> state_map;
+            *clat = prefix_;
+            Splice(det_tail, prefix_final_, clat, &state_map);
+        }
+
+        return ok;
+    }
+
+    void IncrementalDeterminizer::ExtractSegment(const Lattice &raw_lat,
+                                                 const std::vector<int32> &state_times,
+                                                 StateId start_state, int32 start_frame,
+                                                 StateId end_state, int32 end_frame,
+                                                 Lattice *segment) {
+        segment->DeleteStates();
+
+        // Since every path passes through start_state and end_state, the
+        // segment consists of the states at the frames between them.
+        std::vector<StateId> state_map(raw_lat.NumStates(), fst::kNoStateId);
+        for(StateId s = 0; s < raw_lat.NumStates(); s++) {
+            if(state_times[s] >= start_frame && state_times[s] <= end_frame) {
+                state_map[s] = segment->AddState();
+            }
+        }
+        KALDI_ASSERT(state_map[start_state] != fst::kNoStateId);
+        segment->SetStart(state_map[start_state]);
+
+        for(StateId s = 0; s < raw_lat.NumStates(); s++) {
+            if(state_map[s] == fst::kNoStateId)
+                continue;
+
+            for(fst::ArcIterator<Lattice> aiter(raw_lat, s); !aiter.Done(); aiter.Next()) {
+                LatticeArc arc = aiter.Value();
+                if(state_map[arc.nextstate] == fst::kNoStateId)
+                    continue;
+                arc.nextstate = state_map[arc.nextstate];
+                segment->AddArc(state_map[s], arc);
+            }
+
+            if(end_state == fst::kNoStateId) {
+                segment->SetFinal(state_map[s], raw_lat.Final(s));
+            }
+        }
+
+        if(end_state != fst::kNoStateId) {
+            segment->SetFinal(state_map[end_state], LatticeWeight::One());
+        }
+    }
+
+    bool IncrementalDeterminizer::DeterminizeSegment(Lattice *segment, CompactLattice *clat) {
+        bool ok = DeterminizeLatticePhonePrunedWrapper(trans_model_, segment, lattice_beam_, clat, opts_);
+        TopSortCompactLatticeIfNeeded(clat);
+        return ok;
+    }
+}
@@ -0,0 +1,73 @@
+#ifndef ALEX_ASR_INCREMENTAL_LATTICE_H_
+#define ALEX_ASR_INCREMENTAL_LATTICE_H_
+
+#include <vector>
+
+#include "base/kaldi-common.h"
+#include "hmm/transition-model.h"
+#include "lat/determinize-lattice-pruned.h"
+#include "lat/kaldi-lattice.h"
+
+using namespace kaldi;
+
+namespace alex_asr {
+    // Determinizes the raw lattice of a growing utterance incrementally.
+    //
+    // A frame at which the raw lattice has exactly one state is a bottleneck:
+    // every path passes through that state, so the lattice is the
+    // concatenation of the part before it and the part after it, and each part
+    // can be determinized on its own. The determinized part up to a bottleneck
+    // is pushed and minimized, which merges its final states (one per word
+    // sequence) into one, and cached; later calls determinize only the audio
+    // after the cached part and splice the result on. Bottlenecks appear in
+    // pauses, so in long utterances the work per call is roughly proportional
+    // to the audio since the last pause. A bottleneck whose part cannot be
+    // cached (it still ends in several states) is not tried again.
+    //
+    // The result is not the lattice a determinization of the whole utterance
+    // gives. Each part is pruned relative to its own best path; as the best
+    // path of the utterance passes through all bottlenecks, this keeps every
+    // path the full determinization keeps and possibly a few more. Raw
+    // lattice states are also only ever pruned while decoding continues, so a
+    // cached part may keep paths that a later full determinization would
+    // have dropped.
+    //
+    // The raw lattice must come from the same utterance each time; call
+    // Reset() when a new one starts.
+    class IncrementalDeterminizer {
+    public:
+        IncrementalDeterminizer(const TransitionModel &trans_model, BaseFloat lattice_beam,
+                                const fst::DeterminizeLatticePhonePrunedOptions &opts);
+
+        void Reset();
+
+        // Determinizes raw_lat (the whole utterance so far, which is modified) into clat.
+        bool Determinize(Lattice *raw_lat, CompactLattice *clat);
+
+        // Number of frames covered by the cached determinized prefix.
+        int32 NumFramesCached() const { return prefix_frames_; }
+    private:
+        typedef Lattice::StateId StateId;
+
+        const TransitionModel &trans_model_;
+        BaseFloat lattice_beam_;
+        fst::DeterminizeLatticePhonePrunedOptions opts_;
+
+        CompactLattice prefix_;
+        int32 prefix_frames_;  // 0 if nothing is cached.
+        CompactLattice::StateId prefix_final_;
+        int32 tried_frame_;  // Latest bottleneck that could not be cached; 0 if none.
+
+        // Copies the part of raw_lat between start_state and the frame end_frame
+        // into segment. If end_state is not kNoStateId, it is the only state at
+        // end_frame and becomes the only final state; otherwise the final
+        // weights of raw_lat are kept.
+        void ExtractSegment(const Lattice &raw_lat, const std::vector<int32> &state_times,
+                            StateId start_state, int32 start_frame,
+                            StateId end_state, int32 end_frame, Lattice *segment);
+
+        bool DeterminizeSegment(Lattice *segment, CompactLattice *clat);
+    };
+}
+
+#endif  // ALEX_ASR_INCREMENTAL_LATTICE_H_
@@ -0,0 +1,184 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+
+#include "fst/test-properties.h"
+#include "src/mapped_fst.h"
+
+using namespace kaldi;
+
+namespace alex_asr {
+    static const char kMappedFstMagic[8] = {'A', 'L', 'E', 'X', 'M', 'F', 'S', 'T'};
+    static const int32 kMappedFstVersion = 1;
+
+    // Arcs are stored at an offset aligned to this many bytes.
+    static const size_t kMappedFstArcAlignment = 16;
+
+    static size_t ArcsOffset(int64 num_states) {
+        size_t offset = sizeof(MappedStdFst::Header) + num_states * sizeof(MappedStdFst::State);
+        return (offset + kMappedFstArcAlignment - 1) / kMappedFstArcAlignment * kMappedFstArcAlignment;
+    }
+
+    MappedRegion::MappedRegion(const std::string &file_name, size_t offset, size_t length) :
+            map_addr_(NULL),
+            map_length_(0),
+            data_(NULL),
+            length_(length)
+    {
+        int fd = open(file_name.c_str(), O_RDONLY);
+        if (fd == -1) {
+            KALDI_ERR << "Could not open file for mapping: " << file_name << ": " << strerror(errno);
+        }
+
+        // mmap() needs a page aligned offset; map from the preceding page boundary.
+        size_t page_size = sysconf(_SC_PAGESIZE);
+        size_t aligned_offset = offset / page_size * page_size;
+        map_length_ = length + (offset - aligned_offset);
+
+        map_addr_ = mmap(NULL, map_length_, PROT_READ, MAP_SHARED, fd, aligned_offset);
+        close(fd);
+
+        if (map_addr_ == MAP_FAILED) {
+            map_addr_ = NULL;
+            KALDI_ERR << "Could not map file: " << file_name << ": " << strerror(errno);
+        }
+
+        data_ = static_cast<const char *>(map_addr_) + (offset - aligned_offset);
+    }
+
+    MappedRegion::~MappedRegion() {
+        if (map_addr_ != NULL) {
+            munmap(map_addr_, map_length_);
+        }
+    }
+
+    MappedStdFst::MappedStdFst(std::shared_ptr<MappedRegion> region) :
+            region_(region)
+    {
+        header_ = reinterpret_cast<const Header *>(region_->Data());
+        states_ = reinterpret_cast<const State *>(region_->Data() + sizeof(Header));
+        arcs_ = reinterpret_cast<const Arc *>(region_->Data() + ArcsOffset(header_->num_states));
+    }
+
+    MappedStdFst *MappedStdFst::Map(const std::string &file_name, size_t offset) {
+        Header header;
+
+        int fd = open(file_name.c_str(), O_RDONLY);
+        if (fd == -1) {
+            KALDI_ERR << "Could not open mapped FST: " << file_name << ": " << strerror(errno);
+        }
+        struct stat file_stat;
+        if (fstat(fd, &file_stat) != 0) {
+            close(fd);
+            KALDI_ERR << "Could not stat mapped FST: " << file_name << ": " << strerror(errno);
+        }
+        ssize_t n_read = pread(fd, &header, sizeof(header), offset);
+        close(fd);
+
+        if (n_read != sizeof(header) || memcmp(header.magic, kMappedFstMagic, sizeof(kMappedFstMagic)) != 0) {
+            KALDI_ERR << "File is not a mapped FST (convert it with hclg_to_mmap): " << file_name;
+        }
+        if (header.version != kMappedFstVersion || header.arc_size != sizeof(Arc)) {
+            KALDI_ERR << "Mapped FST was written by an incompatible version or architecture: " << file_name;
+        }
+
+        // A truncated file would only fail when the search reads past its end (SIGBUS).
+        // The counts are checked first, so that the length cannot overflow. The header
+        // was read, so the file extends past the offset.
+        uint64 available = static_cast<uint64>(file_stat.st_size) - offset;
+        if (header.num_states < 0 || header.num_arcs < 0
+                || static_cast<uint64>(header.num_states) > available / sizeof(State)
+                || static_cast<uint64>(header.num_arcs) > available / sizeof(Arc)
+                || ArcsOffset(header.num_states) + header.num_arcs * sizeof(Arc) > available) {
+            KALDI_ERR << "Mapped FST is truncated: " << file_name << " has " << available
+                      << " bytes after offset " << offset << ", too few for " << header.num_states
+                      << " states and " << header.num_arcs << " arcs.";
+        }
+
+        size_t length = ArcsOffset(header.num_states) + header.num_arcs * sizeof(Arc);
+        std::shared_ptr<MappedRegion> region(new MappedRegion(file_name, offset, length));
+
+        // The search indexes the states and arcs without checks, so a corrupt state table
+        // is rejected here. One pass over the states is cheap next to the graph; the arcs
+        // themselves are not read, so that they are paged in only when the search needs them.
+        if (header.start != fst::kNoStateId && (header.start < 0 || header.start >= header.num_states)) {
+            KALDI_ERR << "Mapped FST is corrupt: " << file_name << " has start state " << header.start
+                      << " but only " << header.num_states << " states.";
+        }
+        const State *states = reinterpret_cast<const State *>(region->Data() + sizeof(Header));
+        uint64 num_arcs = static_cast<uint64>(header.num_arcs);
+        for (int64 s = 0; s < header.num_states; s++) {
+            const State &state = states[s];
+            if (state.first_arc > num_arcs || state.num_arcs > num_arcs - state.first_arc) {
+                KALDI_ERR << "Mapped FST is corrupt: " << file_name << " state " << s << " has arcs "
+                          << state.first_arc << " to " << state.first_arc + state.num_arcs
+                          << " but only " << header.num_arcs << " arcs.";
+            }
+        }
+
+        KALDI_VLOG(2) << "Mapped FST " << file_name << " with " << header.num_states << " states and "
+                      << header.num_arcs << " arcs.";
+
+        return new MappedStdFst(region);
+    }
+
+    bool MappedStdFst::Write(const fst::ExpandedFst<Arc> &fst, std::ostream &os) {
+        Header header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, kMappedFstMagic, sizeof(kMappedFstMagic));
+        header.version = kMappedFstVersion;
+        header.arc_size = sizeof(Arc);
+        header.start = fst.Start();
+        header.num_states = fst.NumStates();
+        header.properties = fst.Properties(fst::kCopyProperties, false) | fst::kExpanded;
+
+        std::vector<State> states(header.num_states);
+        uint64 num_arcs = 0;
+        for (StateId s = 0; s < header.num_states; s++) {
+            State &state = states[s];
+            state.final_cost = fst.Final(s).Value();
+            state.num_arcs = fst.NumArcs(s);
+            state.num_input_epsilons = fst.NumInputEpsilons(s);
+            state.num_output_epsilons = fst.NumOutputEpsilons(s);
+            state.first_arc = num_arcs;
+            num_arcs += state.num_arcs;
+        }
+        header.num_arcs = num_arcs;
+
+        os.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        if (!states.empty()) {
+            os.write(reinterpret_cast<const char *>(&states[0]), states.size() * sizeof(State));
+        }
+
+        size_t padding = ArcsOffset(header.num_states) - sizeof(header) - states.size() * sizeof(State);
+        for (size_t i = 0; i < padding; i++) {
+            os.put(0);
+        }
+
+        for (StateId s = 0; s < header.num_states; s++) {
+            for (fst::ArcIterator<fst::ExpandedFst<Arc> > aiter(fst, s); !aiter.Done(); aiter.Next()) {
+                const Arc &arc = aiter.Value();
+                os.write(reinterpret_cast<const char *>(&arc), sizeof(Arc));
+            }
+        }
+
+        return os.good();
+    }
+
+    uint64 MappedStdFst::Properties(uint64 mask, bool test) const {
+        if (test) {
+            uint64 known;
+            return fst::TestProperties(*this, mask, &known) & mask;
+        } else {
+            return header_->properties & mask;
+        }
+    }
+
+    const string &MappedStdFst::Type() const {
+        static const string type("alex_mapped");
+        return type;
+    }
+}
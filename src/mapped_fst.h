@@ -0,0 +1,102 @@
+#ifndef ALEX_ASR_MAPPED_FST_H_
+#define ALEX_ASR_MAPPED_FST_H_
+
+#include <memory>
+#include <string>
+#include "fst/fstlib.h"
+#include "base/kaldi-common.h"
+
+using namespace kaldi;
+
+namespace alex_asr {
+    // Read-only memory mapping of (a part of) a file. The mapping is shared by
+    // all MappedStdFst copies that refer to it and is removed with the last one.
+    class MappedRegion {
+    public:
+        MappedRegion(const std::string &file_name, size_t offset, size_t length);
+        ~MappedRegion();
+
+        const char *Data() const { return data_; }
+        size_t Size() const { return length_; }
+    private:
+        void *map_addr_;
+        size_t map_length_;
+        const char *data_;
+        size_t length_;
+
+        KALDI_DISALLOW_COPY_AND_ASSIGN(MappedRegion);
+    };
+
+    // Decoding graph backed by a read-only memory mapped file.
+    //
+    // The file layout is the in-memory layout: a header, an array of states and
+    // an array of fst::StdArc, so mapping the file is all that is needed to start
+    // decoding; pages are loaded lazily and shared through the page cache by all
+    // processes that map the same file. The format is not portable across
+    // architectures with different endianness; use hclg_to_mmap to create it.
+    class MappedStdFst : public fst::ExpandedFst<fst::StdArc> {
+    public:
+        typedef fst::StdArc Arc;
+        typedef Arc::StateId StateId;
+        typedef Arc::Weight Weight;
+
+        struct Header {
+            char magic[8];
+            int32 version;
+            int32 arc_size;
+            int32 start;
+            int32 padding;
+            int64 num_states;
+            int64 num_arcs;
+            uint64 properties;
+        };
+
+        struct State {
+            float final_cost;
+            uint32 num_arcs;
+            uint32 num_input_epsilons;
+            uint32 num_output_epsilons;
+            uint64 first_arc;
+        };
+
+        // Maps a graph written by Write(). The graph starts at byte "offset"
+        // of the file (non-zero when it is a part of a larger archive).
+        static MappedStdFst *Map(const std::string &file_name, size_t offset = 0);
+
+        // Writes the graph in the mappable format. Returns false on error.
+        static bool Write(const fst::ExpandedFst<Arc> &fst, std::ostream &os);
+
+        virtual StateId Start() const { return header_->start; }
+        virtual Weight Final(StateId s) const { return Weight(states_[s].final_cost); }
+        virtual StateId NumStates() const { return header_->num_states; }
+        virtual size_t NumArcs(StateId s) const { return states_[s].num_arcs; }
+        virtual size_t NumInputEpsilons(StateId s) const { return states_[s].num_input_epsilons; }
+        virtual size_t NumOutputEpsilons(StateId s) const { return states_[s].num_output_epsilons; }
+        virtual uint64 Properties(uint64 mask, bool test) const;
+        virtual const string &Type() const;
+        virtual MappedStdFst *Copy(bool safe = false) const { return new MappedStdFst(*this); }
+        virtual const fst::SymbolTable *InputSymbols() const { return NULL; }
+        virtual const fst::SymbolTable *OutputSymbols() const { return NULL; }
+
+        virtual void InitStateIterator(fst::StateIteratorData<Arc> *data) const {
+            data->base = NULL;
+            data->nstates = NumStates();
+        }
+
+        virtual void InitArcIterator(StateId s, fst::ArcIteratorData<Arc> *data) const {
+            data->base = NULL;
+            data->arcs = arcs_ + states_[s].first_arc;
+            data->narcs = states_[s].num_arcs;
+            data->ref_count = NULL;
+        }
+    private:
+        MappedStdFst(std::shared_ptr<MappedRegion> region);
+
+        std::shared_ptr<MappedRegion> region_;
+        const Header *header_;
+        const State *states_;
+        const Arc *arcs_;
+    };
+}
+
+#endif  // ALEX_ASR_MAPPED_FST_H_
@@ -0,0 +1,256 @@
+#include <algorithm>
+#include <exception>
+#include <functional>
+#include <thread>
+
+#include "src/model_bundle.h"
+#include "src/mapped_fst.h"
+#include "src/utils.h"
+
+#include "online2/onlinebin-util.h"
+
+using namespace kaldi;
+
+namespace alex_asr {
+    ModelBundle::ModelBundle(const string model_path) :
+            config_(NULL),
+            trans_model_(NULL),
+            am_nnet2_(NULL),
+            am_gmm_(NULL),
+            nnet2_quantized_(NULL),
+            nnet2_scorer_(NULL),
+            hclg_(NULL),
+            hcl_(NULL),
+            g_(NULL),
+            words_(NULL),
+            word_table_(NULL),
+            pipelines_(NULL),
+            speaker_cache_(NULL),
+            package_(NULL)
+    {
+        KALDI_VLOG(2) << "Loading model bundle: " << model_path;
+
+        if(ModelPackage::IsPackage(model_path)) {
+            package_ = new ModelPackage(model_path);
+        }
+
+        ParseConfig(model_path);
+        LoadModels();
+
+        pipelines_ = new FeaturePipelinePool(*config_, config_->pipeline_pool_size);
+        speaker_cache_ = new AdaptationCache(*config_, config_->speaker_cache_size);
+
+        KALDI_VLOG(2) << "Model bundle is successfully loaded.";
+    }
+
+    ModelBundle::~ModelBundle() {
+        delete pipelines_;  // Uses the config.
+        delete speaker_cache_;  // Uses the config.
+        delete config_;
+        delete trans_model_;
+        delete am_nnet2_;
+        delete am_gmm_;
+        delete nnet2_scorer_;
+        delete nnet2_quantized_;
+        delete hclg_;
+        delete hcl_;
+        delete g_;
+        delete words_;
+        delete word_table_;
+        delete package_;
+    }
+
+    const nnet2::AmNnet &ModelBundle::AmNnet2() const {
+        KALDI_ASSERT(am_nnet2_ != NULL);
+        return *am_nnet2_;
+    }
+
+    const AmDiagGmm &ModelBundle::AmGmm() const {
+        KALDI_ASSERT(am_gmm_ != NULL);
+        return *am_gmm_;
+    }
+
+    const Nnet2Scorer &ModelBundle::Nnet2Scoring() const {
+        KALDI_ASSERT(nnet2_scorer_ != NULL);
+        return *nnet2_scorer_;
+    }
+
+    void ModelBundle::ParseConfig(const string &model_path) {
+        KALDI_PARANOID_ASSERT(config_ == NULL);
+
+        config_ = new DecoderConfig();
+
+        if(package_ != NULL) {
+            config_->LoadPackage(*package_);
+        } else {
+            LoadConfigFile(model_path);
+        }
+
+        if(!config_->InitAndCheck()) {
+            KALDI_ERR << "Error when checking if the configuration is valid. "
+                    "Please check your configuration.";
+        }
+    }
+
+    void ModelBundle::LoadConfigFile(const string &model_path) {
+        string cfg_name;
+        if(FileExists(model_path + "/pykaldi.cfg")) {
+            cfg_name = "pykaldi.cfg";
+            KALDI_WARN << "Using deprecated configuration file. Please move pykaldi.cfg to alex_asr.conf.";
+        } else if(FileExists(model_path + "/alex_asr.conf")) {
+            cfg_name = "alex_asr.conf";
+        } else {
+            KALDI_ERR << "AlexASR Decoder configuration (alex_asr.conf) not found in model directory."
+                    "Please check your configuration.";
+        }
+
+        config_->LoadConfigs(model_path, cfg_name);
+    }
+
+    bool ModelBundle::FileExists(const std::string& name) {
+        struct stat buffer;
+        return (stat (name.c_str(), &buffer) == 0);
+    }
+
+    void ModelBundle::CheckSubsamplingTopology() {
+        // The search takes one HMM transition per (subsampled) frame, so a phone
+        // lasts at least as many frames as its HMM has emitting states on its
+        // shortest path. With subsampling that becomes k times longer.
+        const HmmTopology &topo = trans_model_->GetTopo();
+        const std::vector<int32> &phones = topo.GetPhones();
+        int32 min_length = 0;
+        for(size_t i = 0; i < phones.size(); i++) {
+            min_length = std::max(min_length, topo.MinLength(phones[i]));
+        }
+
+        int32 k = config_->frame_subsampling_factor;
+        if(min_length > 1) {
+            KALDI_WARN << "With --frame_subsampling_factor=" << k << ", phones of this model last at least "
+                       << min_length * k * config_->mfcc_opts.frame_opts.frame_shift_ms
+                       << " ms, as its HMM topology needs up to " << min_length << " frames per phone. "
+                       << "Use a model with a 1-state topology (or retrained for the reduced frame rate).";
+        }
+    }
+
+    // Runs the tasks on threads of their own and rethrows the first exception
+    // any of them threw once all of them finished.
+    static void RunInParallel(const std::vector<std::function<void()> > &tasks) {
+        std::vector<std::exception_ptr> errors(tasks.size());
+        std::vector<std::thread> threads;
+        for(size_t i = 0; i < tasks.size(); i++) {
+            threads.push_back(std::thread([&tasks, &errors, i]() {
+                try {
+                    tasks[i]();
+                } catch(...) {
+                    errors[i] = std::current_exception();
+                }
+            }));
+        }
+
+        for(size_t i = 0; i < threads.size(); i++) {
+            threads[i].join();
+        }
+        for(size_t i = 0; i < errors.size(); i++) {
+            if(errors[i])
+                std::rethrow_exception(errors[i]);
+        }
+    }
+
+    void ModelBundle::LoadModels() {
+        // The models are independent of each other, so they are read at the
+        // same time; the largest (HCLG or the acoustic model) sets the time.
+        std::vector<std::function<void()> > tasks;
+        tasks.push_back([this]() { LoadAcousticModel(); });
+        tasks.push_back([this]() { LoadHclg(); });
+        tasks.push_back([this]() { LoadWords(); });
+        tasks.push_back([this]() { config_->InitAux(); });
+        RunInParallel(tasks);
+
+        if(config_->frame_subsampling_factor > 1) {
+            CheckSubsamplingTopology();
+        }
+    }
+
+    void ModelBundle::LoadAcousticModel() {
+        bool binary;
+        Input ki(config_->model_rxfilename, &binary);
+
+        KALDI_PARANOID_ASSERT(trans_model_ == NULL);
+        trans_model_ = new TransitionModel();
+        trans_model_->Read(ki.Stream(), binary);
+
+        if(config_->model_type == DecoderConfig::GMM) {
+            KALDI_PARANOID_ASSERT(am_gmm_ == NULL);
+            am_gmm_ = new AmDiagGmm();
+            am_gmm_->Read(ki.Stream(), binary);
+        } else if(config_->model_type == DecoderConfig::NNET2) {
+            KALDI_PARANOID_ASSERT(am_nnet2_ == NULL);
+            am_nnet2_ = new nnet2::AmNnet();
+            am_nnet2_->Read(ki.Stream(), binary);
+
+            if(config_->quantize_nnet2) {
+                nnet2_quantized_ = new QuantizedNnet2(am_nnet2_->GetNnet());
+                KALDI_VLOG(2) << "Quantized " << nnet2_quantized_->NumQuantized()
+                              << " affine components to int8 (kernel: " << QuantizedNnet2::KernelName() << ").";
+            }
+
+            nnet2_scorer_ = new Nnet2Scorer(*am_nnet2_, config_->decodable_opts,
+                                            config_->frame_subsampling_factor, nnet2_quantized_);
+        }
+    }
+
+    fst::StdFst *ModelBundle::LoadGraph(const string &rxfilename, const string &package_entry) {
+        if(package_ != NULL) {
+            return MappedStdFst::Map(package_->FileName(), package_->Offset(package_entry));
+        } else if(config_->use_hclg_mmap) {
+            return MappedStdFst::Map(rxfilename);
+        } else {
+            return ReadDecodeGraph(rxfilename);
+        }
+    }
+
+    void ModelBundle::LoadHclg() {
+        KALDI_PARANOID_ASSERT(hclg_ == NULL && hcl_ == NULL && g_ == NULL);
+        if(config_->hcl_rxfilename.empty()) {
+            hclg_ = LoadGraph(config_->fst_rxfilename, "hclg");
+            return;
+        }
+
+        hcl_ = LoadGraph(config_->hcl_rxfilename, "hcl");
+        g_ = LoadGraph(config_->g_rxfilename, "g");
+        // The composition matches the words with binary search in the arcs of
+        // one of the graphs.
+        if(!hcl_->Properties(fst::kOLabelSorted, false) && !g_->Properties(fst::kILabelSorted, false)) {
+            KALDI_ERR << "Sort the input labels of --g (fstarcsort --sort_type=ilabel) "
+                      << "or the output labels of --hcl (fstarcsort --sort_type=olabel).";
+        }
+    }
+
+    std::shared_ptr<const fst::StdFst> ModelBundle::DecodeGraph() const {
+        if(hclg_ != NULL) {
+            return std::shared_ptr<const fst::StdFst>(hclg_, [](const fst::StdFst *) {});
+        }
+
+        fst::CacheOptions cache_opts(true, static_cast<size_t>(config_->compose_cache_mb) << 20);
+        std::lock_guard<std::mutex> lock(compose_mutex_);
+        fst::StdFst *graph = new fst::ComposeFst<fst::StdArc>(*hcl_, *g_, cache_opts);
+        return std::shared_ptr<const fst::StdFst>(graph, [this](const fst::StdFst *graph) {
+            std::lock_guard<std::mutex> lock(compose_mutex_);
+            delete graph;
+        });
+    }
+
+    void ModelBundle::LoadWords() {
+        KALDI_PARANOID_ASSERT(words_ == NULL);
+        if(package_ != NULL) {
+            Input words_input(config_->words_rxfilename);
+            words_ = fst::SymbolTable::Read(words_input.Stream(), "words");
+        } else {
+            words_ = fst::SymbolTable::ReadText(config_->words_rxfilename);
+        }
+        if(words_ == NULL) {
+            KALDI_ERR << "Could not read the word table " << config_->words_rxfilename;
+        }
+        word_table_ = new WordTable(*words_);
+    }
+}
@@ -0,0 +1,92 @@
+#ifndef ALEX_ASR_MODEL_BUNDLE_H_
+#define ALEX_ASR_MODEL_BUNDLE_H_
+
+#include <memory>
+#include <mutex>
+
+#include "fst/fst-decl.h"
+#include "base/kaldi-types.h"
+#include "gmm/am-diag-gmm.h"
+#include "hmm/transition-model.h"
+#include "nnet2/am-nnet.h"
+
+#include "src/adaptation_cache.h"
+#include "src/decoder_config.h"
+#include "src/model_package.h"
+#include "src/nnet2_batch.h"
+#include "src/pipeline_pool.h"
+#include "src/word_table.h"
+
+using namespace kaldi;
+
+namespace alex_asr {
+    // Read-only models loaded from a model directory: the configuration (with
+    // the LDA/CMVN/ivector matrices), the transition model, the acoustic model,
+    // the HCLG graph and the word table. The models are loaded either from a
+    // model directory or from a model package (see ModelPackage). Nothing in the bundle is modified after
+    // construction, so one instance (held through std::shared_ptr) can be used
+    // by any number of Decoder instances at the same time. The only mutable
+    // parts are the thread-safe pool of feature pipelines for the decoders and
+    // the cache of the speakers' adaptation states.
+    //
+    // With --hcl and --g instead of --hclg, the decoding graph is their
+    // composition, expanded lazily as the search reaches its states. The arcs
+    // of the expanded states are cached with a limit (--compose_cache_mb), but
+    // the table of the state pairs grows with every state reached, so decoders
+    // take a new composition for every segment (utterance or re-anchored
+    // part of a stream). The memory then follows the states one segment
+    // reaches instead of the full graph.
+    class ModelBundle {
+    public:
+        ModelBundle(const string model_path);
+        ~ModelBundle();
+
+        const DecoderConfig &Config() const { return *config_; }
+        const TransitionModel &TransModel() const { return *trans_model_; }
+        const nnet2::AmNnet &AmNnet2() const;
+        const AmDiagGmm &AmGmm() const;
+        const Nnet2Scorer &Nnet2Scoring() const;
+        // The graph a decoder searches, held by the decoder. The static HCLG is
+        // shared; a composition caches its states, which is not thread-safe, so
+        // each call returns a new one then.
+        std::shared_ptr<const fst::StdFst> DecodeGraph() const;
+        bool ComposesGraph() const { return hclg_ == NULL; }
+        const fst::SymbolTable &Words() const { return *words_; }
+        // The same words, for turning hypotheses to text.
+        const WordTable &WordTexts() const { return *word_table_; }
+        FeaturePipelinePool &Pipelines() const { return *pipelines_; }
+        AdaptationCache &SpeakerCache() const { return *speaker_cache_; }
+    private:
+        DecoderConfig *config_;
+        TransitionModel *trans_model_;
+        nnet2::AmNnet *am_nnet2_;
+        AmDiagGmm *am_gmm_;
+        QuantizedNnet2 *nnet2_quantized_;
+        Nnet2Scorer *nnet2_scorer_;
+        fst::StdFst *hclg_;  // NULL with --hcl and --g.
+        fst::StdFst *hcl_;
+        fst::StdFst *g_;
+        // The compositions share hcl_ and g_, whose reference counts are not
+        // thread-safe.
+        mutable std::mutex compose_mutex_;
+        fst::SymbolTable *words_;
+        WordTable *word_table_;
+        FeaturePipelinePool *pipelines_;
+        AdaptationCache *speaker_cache_;
+        ModelPackage *package_;  // NULL if loaded from a directory.
+
+        void ParseConfig(const string &model_path);
+        void LoadConfigFile(const string &model_path);
+        void LoadModels();
+        void LoadAcousticModel();
+        void LoadHclg();
+        fst::StdFst *LoadGraph(const string &rxfilename, const string &package_entry);
+        void LoadWords();
+        void CheckSubsamplingTopology();
+        bool FileExists(const std::string& name);
+
+        KALDI_DISALLOW_COPY_AND_ASSIGN(ModelBundle);
+    };
+}
+
+#endif  // ALEX_ASR_MODEL_BUNDLE_H_
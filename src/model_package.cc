@@ -0,0 +1,196 @@
+#include <cstring>
+#include <sstream>
+
+#include "src/model_package.h"
+
+using namespace kaldi;
+
+namespace alex_asr {
+    static const char kPackageMagic[8] = {'A', 'L', 'E', 'X', 'A', 'P', 'K', 'G'};
+    static const int32 kPackageVersion = 1;
+
+    // Entries start at multiples of this, so that mapped entries (the HCLG)
+    // are page aligned.
+    static const uint64 kPackageAlignment = 4096;
+
+    struct PackageHeader {
+        char magic[8];
+        int32 version;
+        int32 num_entries;
+        uint64 index_offset;
+    };
+
+    static bool ReadHeader(std::istream &is, PackageHeader *header) {
+        is.read(reinterpret_cast<char *>(header), sizeof(*header));
+        return is.good() && memcmp(header->magic, kPackageMagic, sizeof(kPackageMagic)) == 0;
+    }
+
+    bool ModelPackage::IsPackage(const std::string &file_name) {
+        std::ifstream is(file_name.c_str(), std::ios::in | std::ios::binary);
+        PackageHeader header;
+        return is.is_open() && ReadHeader(is, &header);
+    }
+
+    ModelPackage::ModelPackage(const std::string &file_name) :
+            file_name_(file_name)
+    {
+        std::ifstream is(file_name.c_str(), std::ios::in | std::ios::binary);
+        if(!is.is_open()) {
+            KALDI_ERR << "Could not open model package " << file_name;
+        }
+
+        PackageHeader header;
+        if(!ReadHeader(is, &header)) {
+            KALDI_ERR << "Not a model package (create it with pack_model): " << file_name;
+        }
+        if(header.version != kPackageVersion) {
+            KALDI_ERR << "Model package " << file_name << " was written by an incompatible version.";
+        }
+
+        is.seekg(header.index_offset);
+        for(int32 i = 0; i < header.num_entries; i++) {
+            std::string name;
+            Entry entry;
+            ReadToken(is, true, &name);
+            ReadBasicType(is, true, &entry.offset);
+            ReadBasicType(is, true, &entry.size);
+            entries_[name] = entry;
+        }
+
+        KALDI_VLOG(2) << "Opened model package " << file_name << " with " << entries_.size() << " entries.";
+    }
+
+    bool ModelPackage::Has(const std::string &name) const {
+        return entries_.count(name) != 0;
+    }
+
+    const ModelPackage::Entry &ModelPackage::GetEntry(const std::string &name) const {
+        std::map<std::string, Entry>::const_iterator it = entries_.find(name);
+        if(it == entries_.end()) {
+            KALDI_ERR << "Model package " << file_name_ << " has no entry " << name;
+        }
+        return it->second;
+    }
+
+    size_t ModelPackage::Offset(const std::string &name) const {
+        return GetEntry(name).offset;
+    }
+
+    std::string ModelPackage::Rxfilename(const std::string &name) const {
+        std::ostringstream rxfilename;
+        rxfilename << file_name_ << ":" << GetEntry(name).offset;
+        return rxfilename.str();
+    }
+
+    void ModelPackage::ParseOptionsEntry(const std::string &name, ParseOptions *po) const {
+        const Entry &entry = GetEntry(name);
+
+        std::string text(entry.size, '\0');
+        std::ifstream is(file_name_.c_str(), std::ios::in | std::ios::binary);
+        is.seekg(entry.offset);
+        if(entry.size > 0 && !is.read(&text[0], entry.size)) {
+            KALDI_ERR << "Could not read entry " << name << " of model package " << file_name_;
+        }
+
+        // The lines are command line options already; the first argument is the
+        // program name and the options are not echoed to stderr.
+        std::vector<std::string> lines;
+        SplitStringToVector(text, "\n", true, &lines);
+        std::vector<const char *> argv;
+        argv.push_back("alex_asr");
+        argv.push_back("--print-args=false");
+        for(size_t i = 0; i < lines.size(); i++) {
+            argv.push_back(lines[i].c_str());
+        }
+        po->Read(argv.size(), &argv[0]);
+
+        KALDI_VLOG(2) << "Config loaded from the package: " << name;
+    }
+
+    ModelPackageWriter::ModelPackageWriter(const std::string &file_name) :
+            file_name_(file_name),
+            os_(file_name.c_str(), std::ios::out | std::ios::binary)
+    {
+        if(!os_.is_open()) {
+            KALDI_ERR << "Could not open " << file_name << " for writing.";
+        }
+        WriteHeader(0, 0);  // Rewritten by Close().
+    }
+
+    ModelPackageWriter::~ModelPackageWriter() {
+        if(os_.is_open()) {
+            KALDI_WARN << "Model package " << file_name_ << " was not closed; it is incomplete.";
+        }
+    }
+
+    void ModelPackageWriter::WriteHeader(int32 num_entries, uint64 index_offset) {
+        PackageHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, kPackageMagic, sizeof(kPackageMagic));
+        header.version = kPackageVersion;
+        header.num_entries = num_entries;
+        header.index_offset = index_offset;
+        os_.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    }
+
+    void ModelPackageWriter::EndEntry() {
+        if(offsets_.size() > sizes_.size()) {
+            sizes_.push_back(static_cast<uint64>(os_.tellp()) - offsets_.back());
+        }
+    }
+
+    std::ostream &ModelPackageWriter::BeginEntry(const std::string &name) {
+        KALDI_ASSERT(!name.empty() && name.find_first_of(" \t\n") == std::string::npos);
+        EndEntry();
+
+        uint64 offset = os_.tellp();
+        uint64 aligned = (offset + kPackageAlignment - 1) / kPackageAlignment * kPackageAlignment;
+        std::string padding(aligned - offset, '\0');
+        os_.write(padding.data(), padding.size());
+
+        names_.push_back(name);
+        offsets_.push_back(aligned);
+        return os_;
+    }
+
+    void ModelPackageWriter::AddOptions(const std::string &name, const std::string &config_file) {
+        std::ifstream is(config_file.c_str());
+        if(!is.is_open()) {
+            KALDI_ERR << "Could not open config file " << config_file;
+        }
+
+        // The same syntax as ParseOptions::ReadConfigFile().
+        std::ostream &os = BeginEntry(name);
+        std::string line;
+        while(std::getline(is, line)) {
+            size_t comment = line.find('#');
+            if(comment != std::string::npos)
+                line.erase(comment);
+            Trim(&line);
+            if(line.empty())
+                continue;
+            if(line.compare(0, 2, "--") != 0) {
+                KALDI_ERR << "Bad line in config file " << config_file << ": " << line;
+            }
+            os << line << '\n';
+        }
+    }
+
+    void ModelPackageWriter::Close() {
+        EndEntry();
+
+        uint64 index_offset = os_.tellp();
+        for(size_t i = 0; i < names_.size(); i++) {
+            WriteToken(os_, true, names_[i]);
+            WriteBasicType(os_, true, offsets_[i]);
+            WriteBasicType(os_, true, sizes_[i]);
+        }
+
+        os_.seekp(0);
+        WriteHeader(names_.size(), index_offset);
+        os_.close();
+        if(os_.fail()) {
+            KALDI_ERR << "Error writing model package " << file_name_;
+        }
+    }
+}
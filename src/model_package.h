@@ -0,0 +1,92 @@
+#ifndef ALEX_ASR_MODEL_PACKAGE_H_
+#define ALEX_ASR_MODEL_PACKAGE_H_
+
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "base/kaldi-common.h"
+#include "util/parse-options.h"
+
+using namespace kaldi;
+
+namespace alex_asr {
+    // A model directory packed into one file by pack_model, which ModelBundle
+    // loads instead of the directory. It holds the options of alex_asr.conf and
+    // of the cfg_* files (without comments, one option per line) and all the
+    // models in the Kaldi binary format, the HCLG in the mappable format of
+    // MappedStdFst and the words as a binary fst::SymbolTable.
+    //
+    // The layout is a header, the entries, each starting at a page boundary,
+    // and the index of the entries (name, offset, size) at the end. Entries are
+    // read with the Kaldi "<file>:<offset>" rxfilenames and the HCLG is mapped
+    // in place, so loading is a few sequential reads and one mmap.
+    class ModelPackage {
+    public:
+        explicit ModelPackage(const std::string &file_name);
+
+        // Is file_name a model package (and not e.g. a model directory)?
+        static bool IsPackage(const std::string &file_name);
+
+        const std::string &FileName() const { return file_name_; }
+        bool Has(const std::string &name) const;
+        size_t Offset(const std::string &name) const;
+        // Kaldi rxfilename of the entry.
+        std::string Rxfilename(const std::string &name) const;
+
+        // Parses the options in entry "name" into opts, which must have a
+        // Register(ParseOptions *) method. Returns false if there is no such entry.
+        template<typename C> bool LoadOptions(const std::string &name, C *opts) const;
+    private:
+        struct Entry {
+            uint64 offset;
+            uint64 size;
+        };
+
+        std::string file_name_;
+        std::map<std::string, Entry> entries_;
+
+        const Entry &GetEntry(const std::string &name) const;
+        void ParseOptionsEntry(const std::string &name, ParseOptions *po) const;
+    };
+
+    // Writes a model package entry by entry.
+    class ModelPackageWriter {
+    public:
+        explicit ModelPackageWriter(const std::string &file_name);
+        ~ModelPackageWriter();
+
+        // Starts a new entry and returns the stream to write it to; the entry
+        // ends with the next BeginEntry() or Close().
+        std::ostream &BeginEntry(const std::string &name);
+        // Adds the options of a Kaldi config file as entry "name".
+        void AddOptions(const std::string &name, const std::string &config_file);
+        // Writes the index. The package is not valid until it is called.
+        void Close();
+    private:
+        std::string file_name_;
+        std::ofstream os_;
+        std::vector<std::string> names_;
+        std::vector<uint64> offsets_;
+        std::vector<uint64> sizes_;
+
+        void EndEntry();
+        void WriteHeader(int32 num_entries, uint64 index_offset);
+
+        KALDI_DISALLOW_COPY_AND_ASSIGN(ModelPackageWriter);
+    };
+
+    template<typename C>
+    bool ModelPackage::LoadOptions(const std::string &name, C *opts) const {
+        if(!Has(name))
+            return false;
+
+        ParseOptions po("");
+        opts->Register(&po);
+        ParseOptionsEntry(name, &po);
+        return true;
+    }
+}
+
+#endif  // ALEX_ASR_MODEL_PACKAGE_H_
@@ -0,0 +1,245 @@
+#include <algorithm>
+
+#include "nnet2/nnet-compute.h"
+
+#include "src/nnet2_batch.h"
+
+using namespace kaldi;
+
+namespace alex_asr {
+    Nnet2Scorer::Nnet2Scorer(const nnet2::AmNnet &am_nnet,
+                             const nnet2::DecodableNnet2OnlineOptions &opts,
+                             int32 frame_subsampling_factor,
+                             const QuantizedNnet2 *quantized) :
+            am_nnet_(am_nnet),
+            acoustic_scale_(opts.acoustic_scale),
+            left_context_(am_nnet.GetNnet().LeftContext()),
+            right_context_(am_nnet.GetNnet().RightContext()),
+            frame_subsampling_factor_(frame_subsampling_factor),
+            quantized_(quantized)
+    {
+        if (!opts.pad_input) {
+            KALDI_ERR << "Batched nnet2 scoring requires --pad-input=true.";
+        }
+        KALDI_ASSERT(frame_subsampling_factor_ >= 1);
+
+        log_priors_ = am_nnet_.Priors();
+        KALDI_ASSERT(log_priors_.Dim() == am_nnet_.NumPdfs() &&
+                     "Priors in neural network not set up.");
+        log_priors_.ApplyLog();
+    }
+
+    int32 Nnet2Scorer::InputDim() const {
+        return am_nnet_.GetNnet().InputDim();
+    }
+
+    int32 Nnet2Scorer::NumPdfs() const {
+        return am_nnet_.NumPdfs();
+    }
+
+    int32 Nnet2Scorer::NumInputRows(int32 num_frames) const {
+        return (num_frames - 1) * frame_subsampling_factor_ + 1 + left_context_ + right_context_;
+    }
+
+    void Nnet2Scorer::Compute(const MatrixBase<BaseFloat> &input, Matrix<BaseFloat> *loglikes) const {
+        int32 num_frames_out = input.NumRows() - left_context_ - right_context_;
+        KALDI_ASSERT(num_frames_out > 0);
+
+        if (quantized_ != NULL) {
+            std::vector<int32> rows(num_frames_out);
+            for (int32 i = 0; i < num_frames_out; i++)
+                rows[i] = i;
+            ComputeRows(input, rows, loglikes);
+            return;
+        }
+
+        CuMatrix<BaseFloat> cu_input(input);
+        CuMatrix<BaseFloat> cu_posteriors(num_frames_out, NumPdfs());
+
+        // The input is already padded by the caller.
+        nnet2::NnetComputation(am_nnet_.GetNnet(), cu_input, false, &cu_posteriors);
+
+        PosteriorsToLoglikes(&cu_posteriors, loglikes);
+    }
+
+    void Nnet2Scorer::ComputeRows(const MatrixBase<BaseFloat> &input, const std::vector<int32> &rows,
+                                  Matrix<BaseFloat> *loglikes) const {
+        KALDI_ASSERT(!rows.empty());
+        const nnet2::Nnet &nnet = am_nnet_.GetNnet();
+        int32 num_components = nnet.NumComponents();
+
+        // offsets[c] are the input rows (frames) that component c has to see;
+        // offsets[num_components] are the frames of the requested output rows.
+        // Going down from the output, every splicing component widens the set
+        // by its context.
+        std::vector<std::vector<int32> > offsets(num_components + 1);
+        for (size_t i = 0; i < rows.size(); i++) {
+            offsets[num_components].push_back(rows[i] + left_context_);
+        }
+        for (int32 c = num_components - 1; c >= 0; c--) {
+            std::vector<int32> context = nnet.GetComponent(c).Context();
+            const std::vector<int32> &out = offsets[c + 1];
+            std::vector<int32> &in = offsets[c];
+            if (context.size() == 1 && context[0] == 0) {
+                in = out;
+                continue;
+            }
+
+            for (size_t i = 0; i < out.size(); i++) {
+                for (size_t j = 0; j < context.size(); j++) {
+                    in.push_back(out[i] + context[j]);
+                }
+            }
+            std::sort(in.begin(), in.end());
+            in.erase(std::unique(in.begin(), in.end()), in.end());
+        }
+        KALDI_ASSERT(offsets[0].front() >= 0 && offsets[0].back() < input.NumRows());
+
+        Matrix<BaseFloat> first_input(offsets[0].size(), input.NumCols(), kUndefined);
+        for (size_t i = 0; i < offsets[0].size(); i++) {
+            first_input.Row(i).CopyFromVec(input.Row(offsets[0][i]));
+        }
+
+        CuMatrix<BaseFloat> cur(first_input);
+        for (int32 c = 0; c < num_components; c++) {
+            const nnet2::Component &component = nnet.GetComponent(c);
+            nnet2::ChunkInfo in_info(component.InputDim(), 1, offsets[c]),
+                    out_info(component.OutputDim(), 1, offsets[c + 1]);
+
+            CuMatrix<BaseFloat> next(offsets[c + 1].size(), component.OutputDim());
+            if (quantized_ != NULL && quantized_->Affine(c) != NULL) {
+                // Quantized inference runs on the CPU only.
+                quantized_->Affine(c)->Propagate(cur.Mat(), &next.Mat());
+            } else {
+                component.Propagate(in_info, out_info, cur, &next);
+            }
+            cur.Swap(&next);
+        }
+
+        PosteriorsToLoglikes(&cur, loglikes);
+    }
+
+    void Nnet2Scorer::PosteriorsToLoglikes(CuMatrix<BaseFloat> *posteriors, Matrix<BaseFloat> *loglikes) const {
+        posteriors->ApplyFloor(1.0e-20);  // Avoid log of zero which leads to NaN.
+        posteriors->ApplyLog();
+        posteriors->AddVecToRows(-1.0, log_priors_);
+        posteriors->Scale(acoustic_scale_);
+
+        loglikes->Resize(0, 0);
+        posteriors->Swap(loglikes);
+    }
+
+    DecodableNnet2Batched::DecodableNnet2Batched(const Nnet2Scorer &scorer,
+                                                 const TransitionModel &trans_model,
+                                                 OnlineFeatureInterface *features) :
+            scorer_(scorer),
+            trans_model_(trans_model),
+            features_(features),
+            begin_frame_(0),
+            num_frames_scored_(0)
+    {
+        KALDI_ASSERT(features_->Dim() == scorer_.InputDim());
+    }
+
+    void DecodableNnet2Batched::Reset(OnlineFeatureInterface *features) {
+        KALDI_ASSERT(features->Dim() == scorer_.InputDim());
+        features_ = features;
+        begin_frame_ = 0;
+        num_frames_scored_ = 0;
+    }
+
+    BaseFloat DecodableNnet2Batched::LogLikelihood(int32 frame, int32 index) {
+        KALDI_ASSERT(frame >= begin_frame_ && frame < num_frames_scored_);
+        int32 pdf_id = trans_model_.TransitionIdToPdf(index);
+        return scaled_loglikes_(frame - begin_frame_, pdf_id);
+    }
+
+    bool DecodableNnet2Batched::IsLastFrame(int32 frame) const {
+        // With subsampling, the frame is the last one if no later feature frame
+        // maps to a frame of the decodable and no more features will come.
+        int32 features_ready = features_->NumFramesReady();
+        if ((frame + 1) * scorer_.FrameSubsamplingFactor() < features_ready)
+            return false;
+        return features_ready > 0 && features_->IsLastFrame(features_ready - 1);
+    }
+
+    int32 DecodableNnet2Batched::NumFramesPending(int32 frame_limit) const {
+        int32 features_ready = features_->NumFramesReady();
+        if (features_ready == 0)
+            return 0;
+
+        int32 frames_ready;
+        if (features_->IsLastFrame(features_ready - 1)) {
+            frames_ready = features_ready;
+        } else {
+            frames_ready = std::max<int32>(0, features_ready - scorer_.RightContext());
+        }
+
+        // Frame t needs feature frame t * k.
+        int32 k = scorer_.FrameSubsamplingFactor();
+        frames_ready = (frames_ready + k - 1) / k;
+
+        if (frame_limit >= 0)
+            frames_ready = std::min(frames_ready, frame_limit);
+
+        return std::max<int32>(0, frames_ready - num_frames_scored_);
+    }
+
+    void DecodableNnet2Batched::GetPendingInput(int32 num_frames, MatrixBase<BaseFloat> *input) const {
+        int32 left_context = scorer_.LeftContext();
+        KALDI_ASSERT(input->NumRows() == scorer_.NumInputRows(num_frames));
+
+        int32 first_feature = num_frames_scored_ * scorer_.FrameSubsamplingFactor(),
+                last_feature = features_->NumFramesReady() - 1;
+        for (int32 r = 0; r < input->NumRows(); r++) {
+            int32 t = first_feature - left_context + r;
+            t = std::max<int32>(0, std::min(t, last_feature));
+
+            SubVector<BaseFloat> row(*input, r);
+            features_->GetFrame(t, &row);
+        }
+    }
+
+    void DecodableNnet2Batched::GetPendingRows(int32 num_frames, int32 first_row,
+                                               std::vector<int32> *rows) const {
+        for (int32 i = 0; i < num_frames; i++) {
+            rows->push_back(first_row + i * scorer_.FrameSubsamplingFactor());
+        }
+    }
+
+    void DecodableNnet2Batched::AcceptLoglikes(const MatrixBase<BaseFloat> &loglikes,
+                                               int32 first_needed_frame) {
+        int32 keep_begin = std::max(begin_frame_, std::min(first_needed_frame, num_frames_scored_));
+        int32 num_keep = num_frames_scored_ - keep_begin;
+
+        Matrix<BaseFloat> new_loglikes(num_keep + loglikes.NumRows(), loglikes.NumCols(), kUndefined);
+        if (num_keep > 0) {
+            new_loglikes.RowRange(0, num_keep).CopyFromMat(
+                    scaled_loglikes_.RowRange(keep_begin - begin_frame_, num_keep));
+        }
+        new_loglikes.RowRange(num_keep, loglikes.NumRows()).CopyFromMat(loglikes);
+
+        scaled_loglikes_.Swap(&new_loglikes);
+        begin_frame_ = keep_begin;
+        num_frames_scored_ += loglikes.NumRows();
+    }
+
+    void DecodableNnet2Batched::ScorePending(int32 frame_limit, int32 first_needed_frame) {
+        int32 num_frames = NumFramesPending(frame_limit);
+        if (num_frames == 0)
+            return;
+
+        Matrix<BaseFloat> input(scorer_.NumInputRows(num_frames), scorer_.InputDim(), kUndefined);
+        GetPendingInput(num_frames, &input);
+
+        Matrix<BaseFloat> loglikes;
+        if (scorer_.FrameSubsamplingFactor() == 1) {
+            scorer_.Compute(input, &loglikes);
+        } else {
+            std::vector<int32> rows;
+            GetPendingRows(num_frames, 0, &rows);
+            scorer_.ComputeRows(input, rows, &loglikes);
+        }
+        AcceptLoglikes(loglikes, first_needed_frame);
+    }
+}
@@ -0,0 +1,121 @@
+#ifndef ALEX_ASR_NNET2_BATCH_H_
+#define ALEX_ASR_NNET2_BATCH_H_
+
+#include "base/kaldi-common.h"
+#include "cudamatrix/cu-matrix.h"
+#include "feat/online-feature.h"
+#include "hmm/transition-model.h"
+#include "itf/decodable-itf.h"
+#include "nnet2/am-nnet.h"
+#include "nnet2/online-nnet2-decodable.h"
+
+#include "src/nnet2_quantized.h"
+
+using namespace kaldi;
+
+namespace alex_asr {
+    // Computes scaled acoustic log-likelihoods (log posteriors minus log priors,
+    // multiplied by the acoustic scale) with a shared nnet2 model. It has no
+    // mutable state, so one instance can serve many streams at once.
+    //
+    // With a frame subsampling factor k > 1, only every k-th frame is scored.
+    // With "quantized" (which must outlive the scorer), the affine components
+    // are computed with int8 weights.
+    class Nnet2Scorer {
+    public:
+        Nnet2Scorer(const nnet2::AmNnet &am_nnet, const nnet2::DecodableNnet2OnlineOptions &opts,
+                    int32 frame_subsampling_factor = 1, const QuantizedNnet2 *quantized = NULL);
+
+        int32 LeftContext() const { return left_context_; }
+        int32 RightContext() const { return right_context_; }
+        int32 FrameSubsamplingFactor() const { return frame_subsampling_factor_; }
+        int32 InputDim() const;
+        int32 NumPdfs() const;
+
+        // Number of input rows needed to score num_frames (subsampled) frames.
+        int32 NumInputRows(int32 num_frames) const;
+
+        // Runs the network on the rows of "input" and produces
+        // input.NumRows() - LeftContext() - RightContext() rows of scaled
+        // log-likelihoods. Output row i belongs to input rows
+        // [i, i + LeftContext() + RightContext()], so chunks of several streams
+        // can be stacked into one input matrix; the output rows that straddle
+        // two chunks are just ignored by the caller.
+        void Compute(const MatrixBase<BaseFloat> &input, Matrix<BaseFloat> *loglikes) const;
+
+        // Like Compute(), but produces only the output rows listed in "rows"
+        // (sorted, e.g. every k-th row with frame subsampling). The network is
+        // propagated component by component, and each component computes only
+        // the frames that the components above it need, so layers above the
+        // last splicing are evaluated only for the requested rows.
+        void ComputeRows(const MatrixBase<BaseFloat> &input, const std::vector<int32> &rows,
+                         Matrix<BaseFloat> *loglikes) const;
+    private:
+        const nnet2::AmNnet &am_nnet_;
+        CuVector<BaseFloat> log_priors_;
+        BaseFloat acoustic_scale_;
+        int32 left_context_;
+        int32 right_context_;
+        int32 frame_subsampling_factor_;
+        const QuantizedNnet2 *quantized_;
+
+        void PosteriorsToLoglikes(CuMatrix<BaseFloat> *posteriors, Matrix<BaseFloat> *loglikes) const;
+    };
+
+    // Decodable of a single stream whose log-likelihoods are computed outside
+    // of it, typically by DecoderGroup together with other streams. The search
+    // only sees the frames that have already been scored.
+    //
+    // The input features are padded at the utterance boundaries by repeating
+    // the first/last frame, the same as DecodableNnet2Online with --pad-input.
+    //
+    // With frame subsampling (see Nnet2Scorer), frame t of the decodable is
+    // feature frame t * k, so the search runs at the reduced frame rate.
+    class DecodableNnet2Batched : public DecodableInterface {
+    public:
+        DecodableNnet2Batched(const Nnet2Scorer &scorer,
+                              const TransitionModel &trans_model,
+                              OnlineFeatureInterface *features);
+
+        virtual BaseFloat LogLikelihood(int32 frame, int32 index);
+        virtual bool IsLastFrame(int32 frame) const;
+        virtual int32 NumFramesReady() const { return num_frames_scored_; }
+        virtual int32 NumIndices() const { return trans_model_.NumTransitionIds(); }
+
+        // Number of frames whose features are available but which are not scored
+        // yet. Frames at or after "frame_limit" are not counted (-1 means no limit).
+        int32 NumFramesPending(int32 frame_limit) const;
+
+        // Fills "input" with the features (including context) needed to score the
+        // next "num_frames" pending frames. It must have
+        // Nnet2Scorer::NumInputRows(num_frames) rows.
+        void GetPendingInput(int32 num_frames, MatrixBase<BaseFloat> *input) const;
+
+        // Appends the rows of the input filled by GetPendingInput() that are to
+        // be scored, shifted by "first_row", for Nnet2Scorer::ComputeRows().
+        void GetPendingRows(int32 num_frames, int32 first_row, std::vector<int32> *rows) const;
+
+        // Stores log-likelihoods of the frames requested by GetPendingInput().
+        // Log-likelihoods of frames before "first_needed_frame" (usually the
+        // number of frames decoded so far) are dropped.
+        void AcceptLoglikes(const MatrixBase<BaseFloat> &loglikes, int32 first_needed_frame);
+
+        // Scores the pending frames up to "frame_limit" on its own.
+        void ScorePending(int32 frame_limit, int32 first_needed_frame);
+
+        // Starts over on the features of a new utterance.
+        void Reset(OnlineFeatureInterface *features);
+    private:
+        const Nnet2Scorer &scorer_;
+        const TransitionModel &trans_model_;
+        OnlineFeatureInterface *features_;
+
+        Matrix<BaseFloat> scaled_loglikes_;
+        int32 begin_frame_;
+        int32 num_frames_scored_;
+
+        KALDI_DISALLOW_COPY_AND_ASSIGN(DecodableNnet2Batched);
+    };
+}
+
+#endif  // ALEX_ASR_NNET2_BATCH_H_
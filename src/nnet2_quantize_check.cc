@@ -0,0 +1,126 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <memory>
+
+#include "feat/wave-reader.h"
+#include "util/common-utils.h"
+#include "src/model_bundle.h"
+#include "src/nnet2_quantized.h"
+#include "src/tool_utils.h"
+
+using namespace kaldi;
+using namespace alex_asr;
+
+typedef std::chrono::steady_clock Clock;
+
+// Features of the whole file, padded with the network's context the same way
+// DecodableNnet2Batched pads them.
+static void ComputeInput(ModelBundle *bundle, const WaveData &wave, const Nnet2Scorer &scorer,
+                         Matrix<BaseFloat> *input) {
+    FeaturePipeline *pipeline = bundle->Pipelines().Acquire();
+    SubVector<BaseFloat> waveform(wave.Data(), 0);
+    pipeline->AcceptWaveform(wave.SampFreq(), waveform);
+    pipeline->InputFinished();
+
+    OnlineFeatureInterface *feature = pipeline->GetFeature();
+    int32 num_frames = feature->NumFramesReady();
+    input->Resize(num_frames > 0 ? scorer.NumInputRows(num_frames) : 0, feature->Dim());
+    for (int32 r = 0; r < input->NumRows(); r++) {
+        int32 t = std::max<int32>(0, std::min(r - scorer.LeftContext(), num_frames - 1));
+        SubVector<BaseFloat> row(*input, r);
+        feature->GetFrame(t, &row);
+    }
+
+    bundle->Pipelines().Release(pipeline);
+}
+
+int main(int argc, char *argv[]) {
+    try {
+        const char *usage =
+                "Compare the log-likelihoods of the int8 quantized nnet2 model (--quantize_nnet2)\n"
+                "with the floating point model and report the speed of both.\n"
+                "\n"
+                "Usage: nnet2_quantize_check [options] <model-dir> <wav-file|wav-list>\n"
+                " e.g.: nnet2_quantize_check model_dir test.wav\n"
+                "A file not ending in .wav is a list of WAV files, one per line.\n";
+
+        ParseOptions po(usage);
+        po.Read(argc, argv);
+
+        if (po.NumArgs() != 2) {
+            po.PrintUsage();
+            return 1;
+        }
+
+        std::string model_dir = po.GetArg(1),
+                input = po.GetArg(2);
+
+        std::vector<std::string> wav_files;
+        std::vector<WaveData> waves;
+        ReadWaveFiles(input, &wav_files, &waves);
+
+        std::unique_ptr<ModelBundle> bundle(new ModelBundle(model_dir));
+        if (bundle->Config().model_type != DecoderConfig::NNET2)
+            KALDI_ERR << "The model in " << model_dir << " is not an nnet2 model.";
+
+        const nnet2::AmNnet &am_nnet = bundle->AmNnet2();
+        QuantizedNnet2 quantized(am_nnet.GetNnet());
+        Nnet2Scorer float_scorer(am_nnet, bundle->Config().decodable_opts),
+                quantized_scorer(am_nnet, bundle->Config().decodable_opts, 1, &quantized);
+        KALDI_LOG << "Quantized " << quantized.NumQuantized() << " of " << am_nnet.GetNnet().NumComponents()
+                  << " components (kernel: " << QuantizedNnet2::KernelName() << ").";
+
+        int64 num_frames = 0, num_same_best = 0;
+        double sum_abs_diff = 0.0, max_abs_diff = 0.0, float_seconds = 0.0, quantized_seconds = 0.0;
+        for (size_t i = 0; i < waves.size(); i++) {
+            Matrix<BaseFloat> features;
+            ComputeInput(bundle.get(), waves[i], float_scorer, &features);
+            if (features.NumRows() == 0)
+                continue;
+
+            Matrix<BaseFloat> float_loglikes, quantized_loglikes;
+            Clock::time_point start = Clock::now();
+            float_scorer.Compute(features, &float_loglikes);
+            float_seconds += SecondsSince(start);
+
+            start = Clock::now();
+            quantized_scorer.Compute(features, &quantized_loglikes);
+            quantized_seconds += SecondsSince(start);
+
+            for (int32 r = 0; r < float_loglikes.NumRows(); r++) {
+                SubVector<BaseFloat> f(float_loglikes, r), q(quantized_loglikes, r);
+                for (int32 p = 0; p < f.Dim(); p++) {
+                    double diff = std::abs(f(p) - q(p));
+                    sum_abs_diff += diff;
+                    max_abs_diff = std::max(max_abs_diff, diff);
+                }
+
+                int32 float_best, quantized_best;
+                f.Max(&float_best);
+                q.Max(&quantized_best);
+                if (float_best == quantized_best)
+                    num_same_best++;
+            }
+            num_frames += float_loglikes.NumRows();
+        }
+
+        if (num_frames == 0)
+            KALDI_ERR << "No frames to compare.";
+
+        // The log-likelihoods are those seen by the search, i.e. multiplied by the acoustic scale.
+        KALDI_LOG << "Compared " << num_frames << " frames of " << waves.size() << " files.";
+        KALDI_LOG << "Scaled log-likelihood difference: mean " << sum_abs_diff / (num_frames * am_nnet.NumPdfs())
+                  << ", max " << max_abs_diff;
+        KALDI_LOG << "Same best pdf in " << 100.0 * num_same_best / num_frames << "% of frames.";
+        double audio_seconds = num_frames * bundle->Config().mfcc_opts.frame_opts.frame_shift_ms * 1.0e-03;
+        KALDI_LOG << "Network real-time factor: float " << float_seconds / audio_seconds
+                  << ", quantized " << quantized_seconds / audio_seconds
+                  << " (" << float_seconds / quantized_seconds << "x faster).";
+
+        return 0;
+    } catch (const std::exception &e) {
+        std::cerr << e.what();
+        return -1;
+    }
+}
@@ -0,0 +1,255 @@
+#include <algorithm>
+#include <cmath>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define ALEX_ASR_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+#include "src/nnet2_quantized.h"
+
+using namespace kaldi;
+
+namespace alex_asr {
+    // Dot products of kTileRows weight rows with kTileFrames quantized input
+    // frames, all "stride" apart and "stride" long (a multiple of kStride),
+    // into sums[r * kTileFrames + f]. Every chunk of a weight row is loaded once
+    // for all the frames of the tile and every chunk of a frame once for all
+    // the rows.
+    typedef void (*TileKernel)(const int8 *w, const int8 *x, int32 stride, int32 *sums);
+
+    static const int32 kStride = 32;
+    static const int32 kTileRows = 4;
+    static const int32 kTileFrames = 2;
+
+    // Weight rows that are multiplied with all the frames before the next
+    // ones, so that they come from memory once per Propagate() and from the
+    // cache for the other frames.
+    static const int32 kBlockBytes = 128 * 1024;
+
+    static void TileGeneric(const int8 *w, const int8 *x, int32 stride, int32 *sums) {
+        for(int32 r = 0; r < kTileRows; r++) {
+            for(int32 f = 0; f < kTileFrames; f++) {
+                const int8 *a = w + r * stride, *b = x + f * stride;
+                int32 sum = 0;
+                for(int32 i = 0; i < stride; i++) {
+                    sum += static_cast<int32>(a[i]) * b[i];
+                }
+                sums[r * kTileFrames + f] = sum;
+            }
+        }
+    }
+
+#ifdef ALEX_ASR_X86_KERNELS
+    // The kernels are compiled for their instruction set only and selected at
+    // run time, so the library still runs on CPUs without it. Values are in
+    // [-127, 127], so the pairwise sums of _madd_epi16 cannot overflow.
+    __attribute__((target("sse4.1")))
+    static inline __m128i Load8Sse41(const int8 *p) {
+        return _mm_cvtepi8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(p)));
+    }
+
+    __attribute__((target("sse4.1")))
+    static inline int32 SumSse41(__m128i v) {
+        v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+        v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+        return _mm_cvtsi128_si32(v);
+    }
+
+    __attribute__((target("sse4.1")))
+    static void TileSse41(const int8 *w, const int8 *x, int32 stride, int32 *sums) {
+        const int8 *w0 = w, *w1 = w + stride, *w2 = w + 2 * stride, *w3 = w + 3 * stride;
+        const int8 *x0 = x, *x1 = x + stride;
+        __m128i s00 = _mm_setzero_si128(), s01 = s00, s10 = s00, s11 = s00,
+                s20 = s00, s21 = s00, s30 = s00, s31 = s00;
+        for(int32 i = 0; i < stride; i += 8) {
+            __m128i v0 = Load8Sse41(x0 + i), v1 = Load8Sse41(x1 + i), u;
+            u = Load8Sse41(w0 + i);
+            s00 = _mm_add_epi32(s00, _mm_madd_epi16(u, v0));
+            s01 = _mm_add_epi32(s01, _mm_madd_epi16(u, v1));
+            u = Load8Sse41(w1 + i);
+            s10 = _mm_add_epi32(s10, _mm_madd_epi16(u, v0));
+            s11 = _mm_add_epi32(s11, _mm_madd_epi16(u, v1));
+            u = Load8Sse41(w2 + i);
+            s20 = _mm_add_epi32(s20, _mm_madd_epi16(u, v0));
+            s21 = _mm_add_epi32(s21, _mm_madd_epi16(u, v1));
+            u = Load8Sse41(w3 + i);
+            s30 = _mm_add_epi32(s30, _mm_madd_epi16(u, v0));
+            s31 = _mm_add_epi32(s31, _mm_madd_epi16(u, v1));
+        }
+        sums[0] = SumSse41(s00); sums[1] = SumSse41(s01);
+        sums[2] = SumSse41(s10); sums[3] = SumSse41(s11);
+        sums[4] = SumSse41(s20); sums[5] = SumSse41(s21);
+        sums[6] = SumSse41(s30); sums[7] = SumSse41(s31);
+    }
+
+    __attribute__((target("avx2")))
+    static inline __m256i Load16Avx2(const int8 *p) {
+        return _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p)));
+    }
+
+    __attribute__((target("avx2")))
+    static inline int32 SumAvx2(__m256i v) {
+        __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+        sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+        sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+        return _mm_cvtsi128_si32(sum);
+    }
+
+    __attribute__((target("avx2")))
+    static void TileAvx2(const int8 *w, const int8 *x, int32 stride, int32 *sums) {
+        const int8 *w0 = w, *w1 = w + stride, *w2 = w + 2 * stride, *w3 = w + 3 * stride;
+        const int8 *x0 = x, *x1 = x + stride;
+        __m256i s00 = _mm256_setzero_si256(), s01 = s00, s10 = s00, s11 = s00,
+                s20 = s00, s21 = s00, s30 = s00, s31 = s00;
+        for(int32 i = 0; i < stride; i += 16) {
+            __m256i v0 = Load16Avx2(x0 + i), v1 = Load16Avx2(x1 + i), u;
+            u = Load16Avx2(w0 + i);
+            s00 = _mm256_add_epi32(s00, _mm256_madd_epi16(u, v0));
+            s01 = _mm256_add_epi32(s01, _mm256_madd_epi16(u, v1));
+            u = Load16Avx2(w1 + i);
+            s10 = _mm256_add_epi32(s10, _mm256_madd_epi16(u, v0));
+            s11 = _mm256_add_epi32(s11, _mm256_madd_epi16(u, v1));
+            u = Load16Avx2(w2 + i);
+            s20 = _mm256_add_epi32(s20, _mm256_madd_epi16(u, v0));
+            s21 = _mm256_add_epi32(s21, _mm256_madd_epi16(u, v1));
+            u = Load16Avx2(w3 + i);
+            s30 = _mm256_add_epi32(s30, _mm256_madd_epi16(u, v0));
+            s31 = _mm256_add_epi32(s31, _mm256_madd_epi16(u, v1));
+        }
+        sums[0] = SumAvx2(s00); sums[1] = SumAvx2(s01);
+        sums[2] = SumAvx2(s10); sums[3] = SumAvx2(s11);
+        sums[4] = SumAvx2(s20); sums[5] = SumAvx2(s21);
+        sums[6] = SumAvx2(s30); sums[7] = SumAvx2(s31);
+    }
+#endif
+
+    static TileKernel SelectKernel(const char **name) {
+#ifdef ALEX_ASR_X86_KERNELS
+        __builtin_cpu_init();
+        if(__builtin_cpu_supports("avx2")) {
+            *name = "avx2";
+            return TileAvx2;
+        }
+        if(__builtin_cpu_supports("sse4.1")) {
+            *name = "sse4.1";
+            return TileSse41;
+        }
+#endif
+        *name = "generic";
+        return TileGeneric;
+    }
+
+    static const char *kernel_name = NULL;
+    static const TileKernel tile_kernel = SelectKernel(&kernel_name);
+
+    // Quantizes "in" to [-127, 127] and returns the scale of the result.
+    static BaseFloat Quantize(const BaseFloat *in, int32 dim, int8 *out) {
+        BaseFloat max_abs = 0.0;
+        for(int32 i = 0; i < dim; i++) {
+            max_abs = std::max(max_abs, std::abs(in[i]));
+        }
+        if(max_abs == 0.0) {
+            std::fill(out, out + dim, 0);
+            return 1.0;
+        }
+
+        BaseFloat scale = max_abs / 127.0, inv_scale = 1.0 / scale;
+        for(int32 i = 0; i < dim; i++) {
+            out[i] = static_cast<int8>(lrintf(in[i] * inv_scale));
+        }
+        return scale;
+    }
+
+    static int32 RoundUp(int32 n, int32 multiple) {
+        return (n + multiple - 1) / multiple * multiple;
+    }
+
+    QuantizedAffine::QuantizedAffine(const nnet2::AffineComponent &affine) {
+        Matrix<BaseFloat> linear(affine.LinearParams());
+        input_dim_ = linear.NumCols();
+        stride_ = RoundUp(input_dim_, kStride);
+
+        // The rows are padded with zero rows to whole tiles.
+        weights_.resize(static_cast<size_t>(RoundUp(linear.NumRows(), kTileRows)) * stride_, 0);
+        weight_scales_.Resize(linear.NumRows());
+        for(int32 r = 0; r < linear.NumRows(); r++) {
+            weight_scales_(r) = Quantize(linear.RowData(r), input_dim_, &weights_[r * stride_]);
+        }
+
+        bias_.Resize(affine.BiasParams().Dim());
+        affine.BiasParams().CopyToVec(&bias_);
+    }
+
+    void QuantizedAffine::Propagate(const MatrixBase<BaseFloat> &in, MatrixBase<BaseFloat> *out) const {
+        KALDI_ASSERT(in.NumCols() == input_dim_ && out->NumCols() == OutputDim()
+                     && in.NumRows() == out->NumRows());
+
+        // The whole input is quantized at once, padded to whole tiles. The
+        // components are shared by the decoders of all threads, so the buffers
+        // are per thread; they only grow.
+        static thread_local std::vector<int8> input;
+        static thread_local std::vector<BaseFloat> input_scales;
+        int32 num_frames = in.NumRows(), output_dim = OutputDim();
+        size_t input_size = static_cast<size_t>(RoundUp(num_frames, kTileFrames)) * stride_;
+        if(input.size() < input_size) {
+            input.resize(input_size, 0);
+        }
+        if(input_scales.size() < static_cast<size_t>(num_frames)) {
+            input_scales.resize(num_frames);
+        }
+        for(int32 f = 0; f < num_frames; f++) {
+            input_scales[f] = Quantize(in.RowData(f), input_dim_, &input[f * stride_]);
+        }
+
+        int32 num_rows = RoundUp(output_dim, kTileRows);
+        int32 block_rows = std::max(kTileRows, kBlockBytes / stride_ / kTileRows * kTileRows);
+        int32 sums[kTileRows * kTileFrames];
+        for(int32 block = 0; block < num_rows; block += block_rows) {
+            int32 block_end = std::min(block + block_rows, num_rows);
+            for(int32 f = 0; f < num_frames; f += kTileFrames) {
+                for(int32 o = block; o < block_end; o += kTileRows) {
+                    tile_kernel(&weights_[o * stride_], &input[f * stride_], stride_, sums);
+                    for(int32 r = 0; r < kTileRows && o + r < output_dim; r++) {
+                        for(int32 t = 0; t < kTileFrames && f + t < num_frames; t++) {
+                            (*out)(f + t, o + r) = sums[r * kTileFrames + t] * input_scales[f + t]
+                                                   * weight_scales_(o + r) + bias_(o + r);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    QuantizedNnet2::QuantizedNnet2(const nnet2::Nnet &nnet) :
+            affine_(nnet.NumComponents(), static_cast<QuantizedAffine *>(NULL))
+    {
+        for(int32 c = 0; c < nnet.NumComponents(); c++) {
+            // Includes the preconditioned variants, which derive from AffineComponent.
+            const nnet2::AffineComponent *affine =
+                    dynamic_cast<const nnet2::AffineComponent *>(&nnet.GetComponent(c));
+            if(affine != NULL) {
+                affine_[c] = new QuantizedAffine(*affine);
+            }
+        }
+    }
+
+    QuantizedNnet2::~QuantizedNnet2() {
+        for(size_t c = 0; c < affine_.size(); c++) {
+            delete affine_[c];
+        }
+    }
+
+    int32 QuantizedNnet2::NumQuantized() const {
+        int32 n = 0;
+        for(size_t c = 0; c < affine_.size(); c++) {
+            if(affine_[c] != NULL)
+                n++;
+        }
+        return n;
+    }
+
+    const char *QuantizedNnet2::KernelName() {
+        return kernel_name;
+    }
+}
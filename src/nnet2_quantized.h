@@ -0,0 +1,59 @@
+#ifndef ALEX_ASR_NNET2_QUANTIZED_H_
+#define ALEX_ASR_NNET2_QUANTIZED_H_
+
+#include <vector>
+
+#include "base/kaldi-common.h"
+#include "matrix/matrix-lib.h"
+#include "nnet2/nnet-component.h"
+#include "nnet2/nnet-nnet.h"
+
+using namespace kaldi;
+
+namespace alex_asr {
+    // Affine transform with int8 weights, quantized symmetrically with one scale
+    // per output row. The input is quantized the same way (one scale per
+    // frame), the products are computed in integers with SSE4.1 or AVX2
+    // (whichever the CPU supports) and the result is rescaled to floating
+    // point. Like a GEMM, the product is blocked over output rows and frames,
+    // so each block of weights is read from memory once for all the frames.
+    class QuantizedAffine {
+    public:
+        explicit QuantizedAffine(const nnet2::AffineComponent &affine);
+
+        int32 InputDim() const { return input_dim_; }
+        int32 OutputDim() const { return bias_.Dim(); }
+
+        // out = in * W^T + b.
+        void Propagate(const MatrixBase<BaseFloat> &in, MatrixBase<BaseFloat> *out) const;
+    private:
+        int32 input_dim_;
+        int32 stride_;  // Input dimension padded for the kernels; the padding is zero.
+        std::vector<int8> weights_;
+        Vector<BaseFloat> weight_scales_;
+        Vector<BaseFloat> bias_;
+    };
+
+    // Quantized versions of the affine components of an nnet2 network; the
+    // other components (nonlinearities, splicing, softmax) are element-wise or
+    // cheap and stay in floating point. Used by Nnet2Scorer with
+    // --quantize_nnet2.
+    class QuantizedNnet2 {
+    public:
+        explicit QuantizedNnet2(const nnet2::Nnet &nnet);
+        ~QuantizedNnet2();
+
+        // The quantized component c, or NULL if it is computed in floating point.
+        const QuantizedAffine *Affine(int32 c) const { return affine_[c]; }
+        int32 NumQuantized() const;
+
+        // Name of the kernel used on this CPU ("avx2", "sse4.1" or "generic").
+        static const char *KernelName();
+    private:
+        std::vector<QuantizedAffine *> affine_;
+
+        KALDI_DISALLOW_COPY_AND_ASSIGN(QuantizedNnet2);
+    };
+}
+
+#endif  // ALEX_ASR_NNET2_QUANTIZED_H_
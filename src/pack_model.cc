@@ -0,0 +1,151 @@
+#include <memory>
+
+#include "base/kaldi-common.h"
+#include "util/common-utils.h"
+#include "gmm/am-diag-gmm.h"
+#include "hmm/transition-model.h"
+#include "nnet2/am-nnet.h"
+#include "online2/onlinebin-util.h"
+
+#include "src/decoder_config.h"
+#include "src/mapped_fst.h"
+#include "src/model_package.h"
+
+using namespace kaldi;
+using namespace alex_asr;
+
+// Starts a Kaldi binary object in entry "name".
+static std::ostream &BeginBinaryEntry(ModelPackageWriter *writer, const std::string &name) {
+    std::ostream &os = writer->BeginEntry(name);
+    InitKaldiOutputStream(os, true);
+    return os;
+}
+
+static void AddOptionsIfExists(ModelPackageWriter *writer, const std::string &name,
+                               const std::string &config_file) {
+    struct stat buffer;
+    if (!config_file.empty() && stat(config_file.c_str(), &buffer) == 0)
+        writer->AddOptions(name, config_file);
+}
+
+static void AddModel(ModelPackageWriter *writer, const DecoderConfig &config) {
+    bool binary;
+    Input ki(config.model_rxfilename, &binary);
+    TransitionModel trans_model;
+    trans_model.Read(ki.Stream(), binary);
+
+    std::ostream &os = BeginBinaryEntry(writer, "model");
+    trans_model.Write(os, true);
+    if (config.model_type == DecoderConfig::GMM) {
+        AmDiagGmm am_gmm;
+        am_gmm.Read(ki.Stream(), binary);
+        am_gmm.Write(os, true);
+    } else {
+        nnet2::AmNnet am_nnet;
+        am_nnet.Read(ki.Stream(), binary);
+        am_nnet.Write(os, true);
+    }
+}
+
+static void AddGraph(ModelPackageWriter *writer, const DecoderConfig &config, const std::string &name,
+                     const std::string &rxfilename) {
+    std::unique_ptr<fst::Fst<fst::StdArc> > graph;
+    if (config.use_hclg_mmap) {
+        graph.reset(MappedStdFst::Map(rxfilename));
+    } else {
+        graph.reset(ReadDecodeGraph(rxfilename));
+    }
+
+    const fst::ExpandedFst<fst::StdArc> *expanded = dynamic_cast<const fst::ExpandedFst<fst::StdArc> *>(graph.get());
+    std::unique_ptr<fst::VectorFst<fst::StdArc> > converted;
+    if (expanded == NULL) {
+        converted.reset(new fst::VectorFst<fst::StdArc>(*graph));
+        expanded = converted.get();
+    }
+
+    if (!MappedStdFst::Write(*expanded, writer->BeginEntry(name)))
+        KALDI_ERR << "Error writing " << rxfilename << " to the package.";
+}
+
+static void AddWords(ModelPackageWriter *writer, const DecoderConfig &config) {
+    std::unique_ptr<fst::SymbolTable> words(fst::SymbolTable::ReadText(config.words_rxfilename));
+    if (!words)
+        KALDI_ERR << "Could not read the word table " << config.words_rxfilename;
+    if (!words->Write(writer->BeginEntry("words")))
+        KALDI_ERR << "Error writing the word table to the package.";
+}
+
+static void AddIvectorExtractor(ModelPackageWriter *writer, const DecoderConfig &config) {
+    const OnlineIvectorExtractionInfo &info = *config.ivector_extraction_info;
+    info.lda_mat.Write(BeginBinaryEntry(writer, "ivector_lda"), true);
+    info.global_cmvn_stats.Write(BeginBinaryEntry(writer, "ivector_cmvn_stats"), true);
+    writer->AddOptions("ivector_cmvn_config", config.ivector_config.cmvn_config_rxfilename);
+    writer->AddOptions("ivector_splice_config", config.ivector_config.splice_config_rxfilename);
+    info.diag_ubm.Write(BeginBinaryEntry(writer, "ivector_diag_ubm"), true);
+    info.extractor.Write(BeginBinaryEntry(writer, "ivector_extractor"), true);
+}
+
+int main(int argc, char *argv[]) {
+    try {
+        const char *usage =
+                "Pack a model directory (alex_asr.conf, the files it refers to and the models)\n"
+                "into one file that Decoder and ModelBundle load instead of the directory.\n"
+                "The models are stored in binary and the HCLG (or HCL and G) in the memory mappable format,\n"
+                "so loading the package needs no text parsing.\n"
+                "\n"
+                "Usage: pack_model [options] <model-dir> <package-file>\n"
+                " e.g.: pack_model model_dir model.pkg\n";
+
+        ParseOptions po(usage);
+        po.Read(argc, argv);
+
+        if (po.NumArgs() != 2) {
+            po.PrintUsage();
+            return 1;
+        }
+
+        std::string model_dir = po.GetArg(1),
+                package_file = po.GetArg(2);
+
+        DecoderConfig config;
+        config.LoadConfigs(model_dir, "alex_asr.conf");
+        if (!config.InitAndCheck())
+            KALDI_ERR << "Invalid configuration in " << model_dir;
+        config.InitAux();
+
+        ModelPackageWriter writer(package_file);
+        writer.AddOptions("alex_asr.conf", model_dir + "/alex_asr.conf");
+        AddOptionsIfExists(&writer, "cfg_decoder", config.cfg_decoder);
+        AddOptionsIfExists(&writer, "cfg_decodable", config.cfg_decodable);
+        AddOptionsIfExists(&writer, "cfg_mfcc", config.cfg_mfcc);
+        AddOptionsIfExists(&writer, "cfg_cmvn", config.cfg_cmvn);
+        AddOptionsIfExists(&writer, "cfg_splice", config.cfg_splice);
+        AddOptionsIfExists(&writer, "cfg_endpoint", config.cfg_endpoint);
+        AddOptionsIfExists(&writer, "cfg_ivector", config.cfg_ivector);
+        AddOptionsIfExists(&writer, "cfg_pitch", config.cfg_pitch);
+
+        AddModel(&writer, config);
+        if (config.hcl_rxfilename.empty()) {
+            AddGraph(&writer, config, "hclg", config.fst_rxfilename);
+        } else {
+            AddGraph(&writer, config, "hcl", config.hcl_rxfilename);
+            AddGraph(&writer, config, "g", config.g_rxfilename);
+        }
+        AddWords(&writer, config);
+
+        if (config.use_lda)
+            config.lda_mat->Write(BeginBinaryEntry(&writer, "mat_lda"), true);
+        if (config.use_cmvn)
+            config.cmvn_mat->Write(BeginBinaryEntry(&writer, "mat_cmvn"), true);
+        if (config.use_ivectors)
+            AddIvectorExtractor(&writer, config);
+
+        writer.Close();
+
+        KALDI_LOG << "Packed " << model_dir << " to " << package_file;
+        return 0;
+    } catch (const std::exception &e) {
+        std::cerr << e.what();
+        return -1;
+    }
+}
@@ -0,0 +1,184 @@
+#include <cstring>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#include <tmmintrin.h>
+#endif
+
+#include "src/pcm_convert.h"
+
+using namespace kaldi;
+
+namespace alex_asr {
+    void PcmFormat::Check() const {
+        if(bits_per_sample != 8 && bits_per_sample != 16 && bits_per_sample != 24 && bits_per_sample != 32) {
+            KALDI_ERR << "Unsupported bits per sample: " << bits_per_sample;
+        }
+        if(is_float && bits_per_sample != 32) {
+            KALDI_ERR << "Float samples have to have 32 bits per sample.";
+        }
+        if(num_channels < 1 || channel < 0 || channel >= num_channels) {
+            KALDI_ERR << "Invalid channel " << channel << " of " << num_channels << " channels.";
+        }
+    }
+
+    int32 NumPcmSamples(const PcmFormat &format, int32 buffer_length) {
+        return buffer_length / (format.BytesPerSample() * format.num_channels);
+    }
+
+    // Each converter reads n samples that are "stride" bytes apart. Contiguous
+    // samples (mono or planar audio) and interleaved 16-bit stereo have SSE2
+    // loops; the samples they leave and other layouts are converted one at a
+    // time. The SSE2 loops never read past the last sample.
+
+    static void ConvertUInt8(const unsigned char *in, int32 stride, int32 n, BaseFloat *out) {
+        for(int32 i = 0; i < n; i++) {
+            out[i] = in[i * stride];
+        }
+    }
+
+    static void ConvertInt16(const unsigned char *in, int32 stride, int32 n, BaseFloat *out) {
+        int32 i = 0;
+#if defined(__SSE2__) && !KALDI_DOUBLEPRECISION
+        if(stride == sizeof(int16)) {
+            for(; i + 8 <= n; i += 8) {
+                __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i * sizeof(int16)));
+                // Sign-extend to 32 bits by moving each sample to the upper half.
+                __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+                __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16);
+                _mm_storeu_ps(out + i, _mm_cvtepi32_ps(lo));
+                _mm_storeu_ps(out + i + 4, _mm_cvtepi32_ps(hi));
+            }
+        } else if(stride == 2 * sizeof(int16)) {
+            // The decoded sample is the lower half of every 32 bits; the load
+            // reaches 2 bytes into the next frame, which is there if i + 4 < n.
+            for(; i + 5 <= n; i += 4) {
+                __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i * stride));
+                _mm_storeu_ps(out + i, _mm_cvtepi32_ps(_mm_srai_epi32(_mm_slli_epi32(x, 16), 16)));
+            }
+        }
+#endif
+        for(; i < n; i++) {
+            int16 v;
+            memcpy(&v, in + i * stride, sizeof(v));
+            out[i] = v;
+        }
+    }
+
+#if defined(__SSE2__) && !KALDI_DOUBLEPRECISION
+    // Byte shuffles need SSSE3, so this loop is compiled for it and only used
+    // on CPUs that have it. Each sample goes to the upper 3 bytes of 32 bits,
+    // as in the scalar loop. Returns the number of samples converted.
+    __attribute__((target("ssse3")))
+    static int32 ConvertInt24Ssse3(const unsigned char *in, int32 n, BaseFloat *out) {
+        const __m128i spread = _mm_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+        const __m128 scale = _mm_set1_ps(1.0f / 65536.0f);
+        int32 i = 0;
+        // 4 samples are 12 bytes, but 16 are loaded.
+        for(; i + 6 <= n; i += 4) {
+            __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i * 3));
+            __m128 v = _mm_cvtepi32_ps(_mm_shuffle_epi8(x, spread));
+            _mm_storeu_ps(out + i, _mm_mul_ps(v, scale));
+        }
+        return i;
+    }
+
+    static bool HasSsse3() {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("ssse3");
+    }
+
+    static const bool has_ssse3 = HasSsse3();
+#endif
+
+    static void ConvertInt24(const unsigned char *in, int32 stride, int32 n, BaseFloat *out) {
+        const BaseFloat scale = 1.0 / 65536.0;  // Sample is shifted by 8 bits; scale to 16 bits.
+        int32 i = 0;
+#if defined(__SSE2__) && !KALDI_DOUBLEPRECISION
+        if(stride == 3 && has_ssse3) {
+            i = ConvertInt24Ssse3(in, n, out);
+        }
+#endif
+        for(; i < n; i++) {
+            const unsigned char *p = in + i * stride;
+            int32 v = static_cast<int32>((static_cast<uint32>(p[0]) << 8) |
+                                         (static_cast<uint32>(p[1]) << 16) |
+                                         (static_cast<uint32>(p[2]) << 24));
+            out[i] = v * scale;
+        }
+    }
+
+    static void ConvertInt32(const unsigned char *in, int32 stride, int32 n, BaseFloat *out) {
+        const BaseFloat scale = 1.0 / 65536.0;
+        int32 i = 0;
+#if defined(__SSE2__) && !KALDI_DOUBLEPRECISION
+        if(stride == sizeof(int32)) {
+            const __m128 scale4 = _mm_set1_ps(scale);
+            for(; i + 4 <= n; i += 4) {
+                __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i * sizeof(int32)));
+                _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(x), scale4));
+            }
+        }
+#endif
+        for(; i < n; i++) {
+            int32 v;
+            memcpy(&v, in + i * stride, sizeof(v));
+            out[i] = v * scale;
+        }
+    }
+
+    static void ConvertFloat32(const unsigned char *in, int32 stride, int32 n, BaseFloat *out) {
+        const BaseFloat scale = 32768.0;
+        int32 i = 0;
+#if defined(__SSE2__) && !KALDI_DOUBLEPRECISION
+        if(stride == sizeof(float)) {
+            const __m128 scale4 = _mm_set1_ps(scale);
+            for(; i + 4 <= n; i += 4) {
+                __m128 x = _mm_loadu_ps(reinterpret_cast<const float *>(in + i * sizeof(float)));
+                _mm_storeu_ps(out + i, _mm_mul_ps(x, scale4));
+            }
+        }
+#endif
+        for(; i < n; i++) {
+            float v;
+            memcpy(&v, in + i * stride, sizeof(v));
+            out[i] = v * scale;
+        }
+    }
+
+    void ConvertPcm(const PcmFormat &format, const unsigned char *buffer, int32 buffer_length,
+                    BaseFloat *out) {
+        int32 n = NumPcmSamples(format, buffer_length);
+        int32 bytes = format.BytesPerSample();
+
+        const unsigned char *in;
+        int32 stride;
+        if(format.interleaved) {
+            in = buffer + format.channel * bytes;
+            stride = format.num_channels * bytes;
+        } else {
+            in = buffer + format.channel * n * bytes;
+            stride = bytes;
+        }
+
+        switch(format.bits_per_sample) {
+            case 8:
+                ConvertUInt8(in, stride, n, out);
+                break;
+            case 16:
+                ConvertInt16(in, stride, n, out);
+                break;
+            case 24:
+                ConvertInt24(in, stride, n, out);
+                break;
+            case 32:
+                if(format.is_float) {
+                    ConvertFloat32(in, stride, n, out);
+                } else {
+                    ConvertInt32(in, stride, n, out);
+                }
+                break;
+            default:
+                KALDI_ERR << "Unsupported bits per sample: " << format.bits_per_sample;
+        }
+    }
+}
@@ -0,0 +1,42 @@
+#ifndef ALEX_ASR_PCM_CONVERT_H_
+#define ALEX_ASR_PCM_CONVERT_H_
+
+#include "base/kaldi-common.h"
+
+using namespace kaldi;
+
+namespace alex_asr {
+    // Layout of raw audio passed to Decoder::FrameIn. Samples are little-endian.
+    struct PcmFormat {
+        int32 bits_per_sample;  // 8 (unsigned), 16, 24 or 32 (signed integers or float).
+        bool is_float;          // 32-bit IEEE float samples in [-1, 1].
+        int32 num_channels;
+        int32 channel;          // The channel that is decoded.
+        bool interleaved;       // Interleaved frames, or planar (one block per channel).
+
+        PcmFormat() :
+                bits_per_sample(16),
+                is_float(false),
+                num_channels(1),
+                channel(0),
+                interleaved(true)
+        { }
+
+        int32 BytesPerSample() const { return bits_per_sample / 8; }
+
+        // Checks that the format is supported; reports the problem with KALDI_ERR.
+        void Check() const;
+    };
+
+    // Number of samples of the decoded channel contained in buffer_length bytes.
+    int32 NumPcmSamples(const PcmFormat &format, int32 buffer_length);
+
+    // Converts the decoded channel of the buffer to floats in the 16-bit integer
+    // range the models are trained on. "out" must have room for
+    // NumPcmSamples(format, buffer_length) values. 8-bit samples are passed
+    // through unchanged as unsigned values, as they always were.
+    void ConvertPcm(const PcmFormat &format, const unsigned char *buffer, int32 buffer_length,
+                    BaseFloat *out);
+}
+
+#endif  // ALEX_ASR_PCM_CONVERT_H_
@@ -0,0 +1,107 @@
+#include "src/pipeline_pool.h"
+
+using namespace kaldi;
+
+namespace alex_asr {
+    FeaturePipelinePool::FeaturePipelinePool(const DecoderConfig &config, int32 size) :
+            config_(config),
+            size_(size),
+            stopping_(false)
+    {
+        KALDI_ASSERT(size_ >= 0);
+
+        if(size_ > 0) {
+            ready_.reserve(size_);
+            thread_ = std::thread(&FeaturePipelinePool::Run, this);
+        }
+    }
+
+    FeaturePipelinePool::~FeaturePipelinePool() {
+        if(thread_.joinable()) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                stopping_ = true;
+            }
+            wake_.notify_one();
+            thread_.join();
+        }
+
+        for(size_t i = 0; i < ready_.size(); i++) {
+            delete ready_[i];
+        }
+        for(size_t i = 0; i < retired_.size(); i++) {
+            delete retired_[i];
+        }
+    }
+
+    FeaturePipeline *FeaturePipelinePool::Acquire() {
+        if(size_ > 0) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if(!ready_.empty()) {
+                FeaturePipeline *pipeline = ready_.back();
+                ready_.pop_back();
+                wake_.notify_one();
+                return pipeline;
+            }
+        }
+
+        return new FeaturePipeline(config_);
+    }
+
+    void FeaturePipelinePool::Release(FeaturePipeline *pipeline) {
+        if(pipeline == NULL)
+            return;
+
+        if(size_ == 0) {
+            delete pipeline;
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            retired_.push_back(pipeline);
+        }
+        wake_.notify_one();
+    }
+
+    void FeaturePipelinePool::Run() {
+        bool can_build = true;
+        std::vector<FeaturePipeline *> retired;
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        while(true) {
+            wake_.wait(lock, [this, can_build] {
+                return stopping_ || !retired_.empty()
+                       || (can_build && ready_.size() < static_cast<size_t>(size_));
+            });
+            if(stopping_)
+                return;
+
+            retired.swap(retired_);
+            bool build = can_build && ready_.size() < static_cast<size_t>(size_);
+
+            lock.unlock();
+
+            for(size_t i = 0; i < retired.size(); i++) {
+                delete retired[i];
+            }
+            retired.clear();
+
+            FeaturePipeline *pipeline = NULL;
+            if(build) {
+                try {
+                    pipeline = new FeaturePipeline(config_);
+                } catch(const std::exception &e) {
+                    // Acquire() builds the pipelines itself and reports the error to the caller.
+                    KALDI_WARN << "Cannot prepare a feature pipeline: " << e.what();
+                    can_build = false;
+                }
+            }
+
+            lock.lock();
+            if(pipeline != NULL) {
+                ready_.push_back(pipeline);
+            }
+        }
+    }
+}
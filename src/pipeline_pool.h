@@ -0,0 +1,53 @@
+#ifndef ALEX_ASR_PIPELINE_POOL_H_
+#define ALEX_ASR_PIPELINE_POOL_H_
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "src/decoder_config.h"
+#include "src/feature_pipeline.h"
+
+using namespace kaldi;
+
+namespace alex_asr {
+    // Fresh feature pipelines for Decoder::Reset().
+    //
+    // Kaldi's online features cannot be cleared once they have seen audio, and
+    // building them (mel banks, FFT tables, the LDA copy, ivector statistics,
+    // the pitch resampler) is the bulk of the work of starting an utterance.
+    // The pool keeps up to "size" pipelines ready and builds them on its own
+    // thread, which also destroys the pipelines returned by Release(), so
+    // neither happens on the thread that decodes. With size 0 there is no
+    // thread and Acquire()/Release() simply create and delete pipelines.
+    //
+    // Used by all decoders of a ModelBundle; the methods are thread-safe.
+    class FeaturePipelinePool {
+    public:
+        FeaturePipelinePool(const DecoderConfig &config, int32 size);
+        ~FeaturePipelinePool();
+
+        // Returns a new pipeline. It is built right away if none is ready.
+        FeaturePipeline *Acquire();
+
+        // Takes back a pipeline returned by Acquire(); NULL is ignored.
+        void Release(FeaturePipeline *pipeline);
+    private:
+        const DecoderConfig &config_;
+        int32 size_;
+
+        std::mutex mutex_;
+        std::condition_variable wake_;
+        std::vector<FeaturePipeline *> ready_;
+        std::vector<FeaturePipeline *> retired_;
+        bool stopping_;
+        std::thread thread_;
+
+        void Run();
+
+        KALDI_DISALLOW_COPY_AND_ASSIGN(FeaturePipelinePool);
+    };
+}
+
+#endif  // ALEX_ASR_PIPELINE_POOL_H_
@@ -0,0 +1,54 @@
+#ifndef ALEX_ASR_REPLAY_BUFFER_H_
+#define ALEX_ASR_REPLAY_BUFFER_H_
+
+#include <algorithm>
+#include <deque>
+#include <vector>
+
+#include "base/kaldi-common.h"
+#include "matrix/matrix-lib.h"
+
+using namespace kaldi;
+
+namespace alex_asr {
+    // The recent audio of a stream, addressed by the position of the samples in
+    // the whole stream. Audio that is no longer needed is dropped from the front
+    // with Forget(), so the buffer only holds what the decoder has not decoded yet.
+    class ReplayBuffer {
+    public:
+        ReplayBuffer() : begin_(0) { }
+
+        void Clear() {
+            samples_.clear();
+            begin_ = 0;
+        }
+
+        void Append(const VectorBase<BaseFloat> &samples) {
+            samples_.insert(samples_.end(), samples.Data(), samples.Data() + samples.Dim());
+        }
+
+        // Position of the first sample held and one past the last one.
+        int64 Begin() const { return begin_; }
+        int64 End() const { return begin_ + samples_.size(); }
+
+        // Drops the samples before "position".
+        void Forget(int64 position) {
+            int64 n = std::min<int64>(position - begin_, samples_.size());
+            if(n <= 0)
+                return;
+            samples_.erase(samples_.begin(), samples_.begin() + n);
+            begin_ += n;
+        }
+
+        // Copies the samples from "position" (not before Begin()) to the end.
+        void CopyFrom(int64 position, std::vector<BaseFloat> *out) const {
+            KALDI_ASSERT(position >= begin_ && position <= End());
+            out->assign(samples_.begin() + (position - begin_), samples_.end());
+        }
+    private:
+        std::deque<BaseFloat> samples_;
+        int64 begin_;
+    };
+}
+
+#endif  // ALEX_ASR_REPLAY_BUFFER_H_
@@ -0,0 +1,304 @@
+#include <pthread.h>
+#include <sched.h>
+
+#include "src/stream_scheduler.h"
+
+using namespace kaldi;
+
+namespace alex_asr {
+    StreamScheduler::Stream::Stream(Decoder *decoder) :
+            decoder(decoder),
+            input_finished(false),
+            removed(false),
+            scheduled(false),
+            decoder_input_finished(false)
+    { }
+
+    StreamScheduler::Stream::~Stream() {
+        delete decoder;
+    }
+
+    StreamScheduler::StreamScheduler(std::shared_ptr<ModelBundle> bundle, int32 num_threads,
+                                     bool pin_threads, int32 chunk_frames) :
+            bundle_(bundle),
+            chunk_frames_(chunk_frames),
+            next_worker_(0),
+            next_stream_id_(0),
+            num_queued_(0),
+            stopping_(false)
+    {
+        KALDI_ASSERT(bundle_);
+        KALDI_ASSERT(num_threads > 0 && chunk_frames > 0);
+
+        for(int32 i = 0; i < num_threads; i++) {
+            workers_.push_back(new Worker());
+        }
+
+        for(int32 i = 0; i < num_threads; i++) {
+            workers_[i]->thread = std::thread(&StreamScheduler::WorkerLoop, this, i);
+            if(pin_threads) {
+                PinThread(i);
+            }
+        }
+    }
+
+    StreamScheduler::~StreamScheduler() {
+        {
+            std::lock_guard<std::mutex> lock(wake_mutex_);
+            stopping_ = true;
+        }
+        wake_.notify_all();
+
+        for(size_t i = 0; i < workers_.size(); i++) {
+            workers_[i]->thread.join();
+            delete workers_[i];
+        }
+    }
+
+    int32 StreamScheduler::AddStream() {
+        std::shared_ptr<Stream> stream(new Stream(new Decoder(bundle_)));
+
+        std::lock_guard<std::mutex> lock(streams_mutex_);
+        int32 stream_id = next_stream_id_++;
+        streams_[stream_id] = stream;
+        return stream_id;
+    }
+
+    void StreamScheduler::RemoveStream(int32 stream_id) {
+        std::shared_ptr<Stream> stream = GetStream(stream_id);
+        {
+            std::lock_guard<std::mutex> lock(stream->mutex);
+            stream->removed = true;
+        }
+
+        // A worker may still hold the stream; it is deleted with the last reference.
+        std::lock_guard<std::mutex> lock(streams_mutex_);
+        streams_.erase(stream_id);
+    }
+
+    void StreamScheduler::PushAudio(int32 stream_id, const unsigned char *buffer, int32 buffer_length) {
+        std::shared_ptr<Stream> stream = GetStream(stream_id);
+
+        std::lock_guard<std::mutex> lock(stream->mutex);
+        // Audio pushed after InputFinished() belongs to the next utterance.
+        std::vector<unsigned char> &audio = stream->input_finished ? stream->next_audio : stream->audio;
+        audio.insert(audio.end(), buffer, buffer + buffer_length);
+
+        if(!stream->scheduled && !stream->input_finished) {
+            stream->scheduled = true;
+            Schedule(stream);
+        }
+    }
+
+    void StreamScheduler::InputFinished(int32 stream_id) {
+        std::shared_ptr<Stream> stream = GetStream(stream_id);
+
+        std::lock_guard<std::mutex> lock(stream->mutex);
+        stream->input_finished = true;
+
+        if(!stream->scheduled) {
+            stream->scheduled = true;
+            Schedule(stream);
+        }
+    }
+
+    bool StreamScheduler::PollResult(int32 stream_id, StreamResult *result) {
+        std::shared_ptr<Stream> stream = GetStream(stream_id);
+
+        std::lock_guard<std::mutex> lock(stream->mutex);
+        if(stream->results.empty())
+            return false;
+
+        *result = stream->results.front();
+        stream->results.pop_front();
+        return true;
+    }
+
+    std::shared_ptr<StreamScheduler::Stream> StreamScheduler::GetStream(int32 stream_id) {
+        std::lock_guard<std::mutex> lock(streams_mutex_);
+        std::map<int32, std::shared_ptr<Stream> >::iterator it = streams_.find(stream_id);
+        if(it == streams_.end()) {
+            KALDI_ERR << "Unknown stream: " << stream_id;
+        }
+        return it->second;
+    }
+
+    void StreamScheduler::Schedule(std::shared_ptr<Stream> stream) {
+        Worker *worker;
+        {
+            std::lock_guard<std::mutex> lock(wake_mutex_);
+            worker = workers_[next_worker_];
+            next_worker_ = (next_worker_ + 1) % workers_.size();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(worker->mutex);
+            worker->queue.push_back(stream);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(wake_mutex_);
+            num_queued_++;
+        }
+        wake_.notify_one();
+    }
+
+    std::shared_ptr<StreamScheduler::Stream> StreamScheduler::NextStream(int32 worker_index) {
+        std::shared_ptr<Stream> stream;
+
+        // Take the oldest stream from our own queue, or steal the newest one from another worker.
+        for(size_t i = 0; i < workers_.size() && !stream; i++) {
+            Worker *worker = workers_[(worker_index + i) % workers_.size()];
+
+            std::lock_guard<std::mutex> lock(worker->mutex);
+            if(worker->queue.empty())
+                continue;
+
+            if(i == 0) {
+                stream = worker->queue.front();
+                worker->queue.pop_front();
+            } else {
+                stream = worker->queue.back();
+                worker->queue.pop_back();
+            }
+        }
+
+        if(stream) {
+            std::lock_guard<std::mutex> lock(wake_mutex_);
+            num_queued_--;
+        }
+
+        return stream;
+    }
+
+    void StreamScheduler::WorkerLoop(int32 worker_index) {
+        while(true) {
+            std::shared_ptr<Stream> stream = NextStream(worker_index);
+
+            if(stream) {
+                ProcessStream(stream);
+            } else {
+                std::unique_lock<std::mutex> lock(wake_mutex_);
+                wake_.wait(lock, [this] { return stopping_ || num_queued_ > 0; });
+                if(stopping_)
+                    return;
+            }
+        }
+    }
+
+    void StreamScheduler::ProcessStream(std::shared_ptr<Stream> stream) {
+        std::vector<unsigned char> audio;
+        bool input_finished;
+        {
+            std::lock_guard<std::mutex> lock(stream->mutex);
+            if(stream->removed) {
+                stream->scheduled = false;
+                return;
+            }
+            audio.swap(stream->audio);
+            input_finished = stream->input_finished;
+        }
+
+        Decoder *decoder = stream->decoder;
+        StreamResult result;
+        bool have_result = false;
+        bool utterance_done = false;
+        int32 num_decoded = 0;
+
+        try {
+            if(!audio.empty()) {
+                decoder->FrameIn(&audio[0], audio.size());
+            }
+            if(input_finished && !stream->decoder_input_finished) {
+                decoder->InputFinished();
+                stream->decoder_input_finished = true;
+            }
+
+            num_decoded = decoder->Decode(chunk_frames_);
+
+            if(stream->decoder_input_finished && num_decoded < chunk_frames_) {
+                // All audio of the utterance is decoded.
+                decoder->FinalizeDecoding();
+                result.is_final = true;
+                utterance_done = true;
+            } else {
+                result.is_final = false;
+            }
+
+            if(decoder->NumFramesDecoded() > 0 && (num_decoded > 0 || utterance_done)) {
+                decoder->GetBestPath(&result.words, &result.cost);
+                result.num_frames_decoded = decoder->NumFramesDecoded();
+                result.error = false;
+
+                have_result = utterance_done || result.words != stream->last_words;
+                stream->last_words = result.words;
+            } else if(utterance_done) {
+                result.words.clear();
+                result.cost = 0.0;
+                result.num_frames_decoded = 0;
+                result.error = false;
+                have_result = true;
+            }
+        } catch(const std::exception &e) {
+            KALDI_WARN << "Decoding of a stream failed: " << e.what();
+            result.is_final = true;
+            result.error = true;
+            result.cost = 0.0;
+            result.num_frames_decoded = 0;
+            result.words.clear();
+            have_result = true;
+            utterance_done = true;
+        }
+
+        if(utterance_done) {
+            try {
+                decoder->Reset();
+            } catch(const std::exception &e) {
+                KALDI_WARN << "Reset of a stream failed: " << e.what();
+            }
+            stream->decoder_input_finished = false;
+            stream->last_words.clear();
+        }
+
+        std::lock_guard<std::mutex> lock(stream->mutex);
+        if(have_result) {
+            stream->results.push_back(result);
+        }
+        if(utterance_done) {
+            stream->input_finished = false;
+            stream->audio.swap(stream->next_audio);
+            stream->next_audio.clear();
+        }
+
+        bool more_work = !stream->audio.empty()
+                         || num_decoded == chunk_frames_
+                         || (stream->input_finished && !stream->decoder_input_finished);
+        if(more_work && !stream->removed) {
+            Schedule(stream);
+        } else {
+            stream->scheduled = false;
+        }
+    }
+
+    void StreamScheduler::PinThread(int32 worker_index) {
+#ifdef __linux__
+        int32 num_cpus = std::thread::hardware_concurrency();
+        if(num_cpus <= 0) {
+            KALDI_WARN << "Cannot pin worker threads; the number of CPUs is unknown.";
+            return;
+        }
+
+        cpu_set_t cpu_set;
+        CPU_ZERO(&cpu_set);
+        CPU_SET(worker_index % num_cpus, &cpu_set);
+
+        int ret = pthread_setaffinity_np(workers_[worker_index]->thread.native_handle(),
+                                         sizeof(cpu_set), &cpu_set);
+        if(ret != 0) {
+            KALDI_WARN << "Could not pin worker thread " << worker_index << " to a CPU.";
+        }
+#else
+        KALDI_WARN << "Pinning worker threads to CPUs is supported only on Linux.";
+#endif
+    }
+}
@@ -0,0 +1,105 @@
+#ifndef ALEX_ASR_STREAM_SCHEDULER_H_
+#define ALEX_ASR_STREAM_SCHEDULER_H_
+
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "src/decoder.h"
+#include "src/model_bundle.h"
+
+using namespace kaldi;
+
+namespace alex_asr {
+    struct StreamResult {
+        bool is_final;    // The utterance is finished and the stream is ready for the next one.
+        bool error;       // Decoding failed; the stream is reset.
+        BaseFloat cost;
+        int32 num_frames_decoded;
+        std::vector<int32> words;
+    };
+
+    // Decodes many streams on a pool of worker threads.
+    //
+    // Audio is pushed to a stream from any thread; the stream is then queued to
+    // one of the workers, which feeds the audio to the stream's decoder and
+    // decodes at most chunk_frames frames before requeueing it, so that the
+    // streams share the workers fairly. Idle workers steal queued streams from
+    // the other workers. A stream is processed by at most one worker at a time.
+    //
+    // Whenever the best hypothesis of a stream changes, a result is queued for
+    // PollResult(). After InputFinished() is called and all audio is decoded, a
+    // final result is queued and the stream is reset for the next utterance.
+    class StreamScheduler {
+    public:
+        StreamScheduler(std::shared_ptr<ModelBundle> bundle, int32 num_threads,
+                        bool pin_threads = false, int32 chunk_frames = 20);
+        ~StreamScheduler();
+
+        int32 AddStream();
+        void RemoveStream(int32 stream_id);
+
+        // Audio is interpreted as in Decoder::FrameIn.
+        void PushAudio(int32 stream_id, const unsigned char *buffer, int32 buffer_length);
+        void InputFinished(int32 stream_id);
+
+        // Pops the oldest result of the stream. Returns false if there is none.
+        bool PollResult(int32 stream_id, StreamResult *result);
+    private:
+        struct Stream {
+            Stream(Decoder *decoder);
+            ~Stream();
+
+            Decoder *decoder;
+
+            // Protects the members below, up to the worker-only state.
+            std::mutex mutex;
+            std::vector<unsigned char> audio;
+            std::vector<unsigned char> next_audio;  // Pushed after InputFinished().
+            bool input_finished;
+            bool removed;
+            bool scheduled;  // Queued at a worker or being processed.
+            std::deque<StreamResult> results;
+
+            // Used only by the worker that currently processes the stream.
+            bool decoder_input_finished;
+            std::vector<int32> last_words;
+        };
+
+        struct Worker {
+            std::thread thread;
+            std::mutex mutex;
+            std::deque<std::shared_ptr<Stream> > queue;
+        };
+
+        std::shared_ptr<ModelBundle> bundle_;
+        int32 chunk_frames_;
+
+        std::vector<Worker *> workers_;
+        int32 next_worker_;
+
+        std::mutex streams_mutex_;
+        std::map<int32, std::shared_ptr<Stream> > streams_;
+        int32 next_stream_id_;
+
+        std::mutex wake_mutex_;
+        std::condition_variable wake_;
+        int32 num_queued_;
+        bool stopping_;
+
+        std::shared_ptr<Stream> GetStream(int32 stream_id);
+        void Schedule(std::shared_ptr<Stream> stream);
+        std::shared_ptr<Stream> NextStream(int32 worker_index);
+        void WorkerLoop(int32 worker_index);
+        void ProcessStream(std::shared_ptr<Stream> stream);
+        void PinThread(int32 worker_index);
+
+        KALDI_DISALLOW_COPY_AND_ASSIGN(StreamScheduler);
+    };
+}
+
+#endif  // ALEX_ASR_STREAM_SCHEDULER_H_
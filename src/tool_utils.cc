@@ -0,0 +1,37 @@
+#include <fstream>
+
+#include "src/tool_utils.h"
+
+using namespace kaldi;
+
+namespace alex_asr {
+    double SecondsSince(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    void ReadWaveFiles(const std::string &input, std::vector<std::string> *wav_files,
+                       std::vector<WaveData> *waves) {
+        wav_files->clear();
+        if(input.size() >= 4 && input.compare(input.size() - 4, 4, ".wav") == 0) {
+            wav_files->push_back(input);
+        } else {
+            std::ifstream list(input.c_str());
+            if(!list)
+                KALDI_ERR << "Cannot open the list of WAV files " << input;
+            std::string line;
+            while(std::getline(list, line)) {
+                if(!line.empty())
+                    wav_files->push_back(line);
+            }
+        }
+
+        waves->clear();
+        waves->resize(wav_files->size());
+        for(size_t i = 0; i < wav_files->size(); i++) {
+            std::ifstream is((*wav_files)[i].c_str(), std::ios::in | std::ios::binary);
+            if(!is)
+                KALDI_ERR << "Cannot open " << (*wav_files)[i];
+            (*waves)[i].Read(is);
+        }
+    }
+}
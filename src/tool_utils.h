@@ -0,0 +1,25 @@
+#ifndef ALEX_ASR_TOOL_UTILS_H_
+#define ALEX_ASR_TOOL_UTILS_H_
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "base/kaldi-common.h"
+#include "feat/wave-reader.h"
+
+using namespace kaldi;
+
+namespace alex_asr {
+    // Helpers of the command line tools; not part of the library.
+
+    // Seconds elapsed since "start".
+    double SecondsSince(std::chrono::steady_clock::time_point start);
+
+    // Reads "input", a WAV file (ending in .wav) or a list of WAV files, one
+    // per line. The names are stored in wav_files and the audio in waves.
+    void ReadWaveFiles(const std::string &input, std::vector<std::string> *wav_files,
+                       std::vector<WaveData> *waves);
+}
+
+#endif  // ALEX_ASR_TOOL_UTILS_H_
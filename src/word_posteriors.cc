@@ -0,0 +1,295 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define ALEX_ASR_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+#include "src/utils.h"
+#include "src/word_posteriors.h"
+
+using namespace kaldi;
+
+namespace alex_asr {
+    typedef CompactLattice::StateId StateId;
+
+    // States reachable from the start in topological order (by reverse
+    // postorder of a depth-first search). Returns false if the lattice has a
+    // cycle.
+    static bool TopologicalOrder(const CompactLattice &clat, std::vector<StateId> *order) {
+        enum { kNew = 0, kOpen, kDone };
+        std::vector<char> color(clat.NumStates(), kNew);
+        std::vector<std::pair<StateId, size_t> > stack;
+
+        order->clear();
+        stack.push_back(std::make_pair(clat.Start(), 0));
+        color[clat.Start()] = kOpen;
+        while(!stack.empty()) {
+            StateId s = stack.back().first;
+            size_t pos = stack.back().second;
+            if(pos == clat.NumArcs(s)) {
+                color[s] = kDone;
+                order->push_back(s);
+                stack.pop_back();
+                continue;
+            }
+
+            stack.back().second++;
+            fst::ArcIterator<CompactLattice> aiter(clat, s);
+            aiter.Seek(pos);
+            StateId next = aiter.Value().nextstate;
+            if(color[next] == kOpen)
+                return false;
+            if(color[next] == kNew) {
+                color[next] = kOpen;
+                stack.push_back(std::make_pair(next, 0));
+            }
+        }
+
+        std::reverse(order->begin(), order->end());
+        return true;
+    }
+
+    // Sum of exp(terms[i] - max) over terms that are at most max.
+    typedef double (*SumExpKernel)(const double *terms, size_t num_terms, double max);
+
+    static double SumExpGeneric(const double *terms, size_t num_terms, double max) {
+        double sum = 0.0;
+        for(size_t i = 0; i < num_terms; i++) {
+            sum += std::exp(terms[i] - max);
+        }
+        return sum;
+    }
+
+#ifdef ALEX_ASR_X86_KERNELS
+    // Taylor coefficients of exp(r), highest order first.
+    static const double kExpCoefs[] = {
+        1.0 / 479001600.0, 1.0 / 39916800.0, 1.0 / 3628800.0, 1.0 / 362880.0, 1.0 / 40320.0,
+        1.0 / 5040.0, 1.0 / 720.0, 1.0 / 120.0, 1.0 / 24.0, 1.0 / 6.0, 1.0 / 2.0, 1.0, 1.0
+    };
+
+    // exp() of four arguments that are at most 0, within 1e-15 of std::exp():
+    // x = n ln(2) + r with |r| <= ln(2) / 2, exp(r) from its Taylor polynomial
+    // and 2^n written into the exponent bits. Rounding by adding 1.5 * 2^52
+    // leaves n in the low bits of the sum. Arguments below -708 (-inf
+    // included), whose 2^n would not be a normal number, give 0.
+    __attribute__((target("avx2")))
+    static inline __m256d ExpAvx2(__m256d x) {
+        const __m256d round = _mm256_set1_pd(6755399441055744.0);
+        const __m256d min_arg = _mm256_set1_pd(-708.0);
+        __m256d underflow = _mm256_cmp_pd(x, min_arg, _CMP_LT_OQ);
+        x = _mm256_max_pd(x, min_arg);
+
+        __m256d n_rounded = _mm256_add_pd(_mm256_mul_pd(x, _mm256_set1_pd(1.4426950408889634)), round);
+        __m256d n = _mm256_sub_pd(n_rounded, round);
+        // ln(2) in two parts, the first with few enough bits that n times it is exact.
+        __m256d r = _mm256_sub_pd(x, _mm256_mul_pd(n, _mm256_set1_pd(6.93145751953125e-1)));
+        r = _mm256_sub_pd(r, _mm256_mul_pd(n, _mm256_set1_pd(1.42860682030941723212e-6)));
+
+        __m256d p = _mm256_set1_pd(kExpCoefs[0]);
+        for(size_t k = 1; k < sizeof(kExpCoefs) / sizeof(kExpCoefs[0]); k++) {
+            p = _mm256_add_pd(_mm256_mul_pd(p, r), _mm256_set1_pd(kExpCoefs[k]));
+        }
+
+        __m256i scale = _mm256_slli_epi64(_mm256_add_epi64(_mm256_castpd_si256(n_rounded),
+                                                           _mm256_set1_epi64x(1023)), 52);
+        return _mm256_andnot_pd(underflow, _mm256_mul_pd(p, _mm256_castsi256_pd(scale)));
+    }
+
+    __attribute__((target("avx2")))
+    static double SumExpAvx2(const double *terms, size_t num_terms, double max) {
+        __m256d shift = _mm256_set1_pd(max);
+        __m256d sum = _mm256_setzero_pd();
+        size_t i = 0;
+        for(; i + 4 <= num_terms; i += 4) {
+            sum = _mm256_add_pd(sum, ExpAvx2(_mm256_sub_pd(_mm256_loadu_pd(terms + i), shift)));
+        }
+
+        double lanes[4];
+        _mm256_storeu_pd(lanes, sum);
+        return lanes[0] + lanes[1] + lanes[2] + lanes[3] + SumExpGeneric(terms + i, num_terms - i, max);
+    }
+#endif
+
+    static SumExpKernel SelectSumExp() {
+#ifdef ALEX_ASR_X86_KERNELS
+        __builtin_cpu_init();
+        if(__builtin_cpu_supports("avx2"))
+            return SumExpAvx2;
+#endif
+        return SumExpGeneric;
+    }
+
+    static const SumExpKernel sum_exp = SelectSumExp();
+
+    // log(sum(exp(terms))) with a single log(), instead of a LogAdd() (exp and
+    // log1p) per term.
+    static double LogSumExp(const std::vector<double> &terms) {
+        if(terms.empty())
+            return kLogZeroDouble;
+
+        double max = *std::max_element(terms.begin(), terms.end());
+        if(max == kLogZeroDouble)
+            return kLogZeroDouble;
+
+        return max + std::log(sum_exp(&terms[0], terms.size(), max));
+    }
+
+    // The outgoing arcs of a state of the result: what makes two states
+    // equivalent once the weights are pushed.
+    struct PostArc {
+        int32 label;
+        int32 next_class;
+        int64 quantized_weight;
+        double weight;
+
+        bool operator<(const PostArc &other) const {
+            if(label != other.label)
+                return label < other.label;
+            if(next_class != other.next_class)
+                return next_class < other.next_class;
+            return quantized_weight < other.quantized_weight;
+        }
+    };
+
+    struct SignatureHash {
+        size_t operator()(const std::vector<int64> &signature) const {
+            size_t hash = signature.size();
+            for(size_t i = 0; i < signature.size(); i++) {
+                hash = hash * 7853 + static_cast<size_t>(signature[i]);
+            }
+            return hash;
+        }
+    };
+
+    double CompactLatticeToWordPosteriors(const CompactLattice &clat, fst::VectorFst<fst::LogArc> *pst) {
+        pst->DeleteStates();
+        if(clat.Start() == fst::kNoStateId)
+            return kLogZeroDouble;
+
+        std::vector<StateId> order;
+        if(!TopologicalOrder(clat, &order)) {
+            CompactLattice copy(clat);
+            return CompactLatticeToWordsPost(copy, pst);
+        }
+
+        // Class 0 is the final state of the result.
+        const int32 kFinalClass = 0;
+        std::vector<std::vector<PostArc> > class_arcs(1);
+        std::vector<int32> class_height(1, 0);
+        std::unordered_map<std::vector<int64>, int32, SignatureHash> classes;
+
+        std::vector<double> beta(clat.NumStates(), kLogZeroDouble);
+        std::vector<int32> state_class(clat.NumStates(), -1);
+        std::vector<double> terms;
+        std::vector<PostArc> arcs;
+        std::vector<int64> signature;
+
+        // Backward pass: the states after s are done when s is reached.
+        for(size_t i = order.size(); i-- > 0; ) {
+            StateId s = order[i];
+
+            terms.clear();
+            CompactLatticeWeight final_weight = clat.Final(s);
+            if(final_weight != CompactLatticeWeight::Zero()) {
+                terms.push_back(-(final_weight.Weight().Value1() + final_weight.Weight().Value2()));
+            }
+            for(fst::ArcIterator<CompactLattice> aiter(clat, s); !aiter.Done(); aiter.Next()) {
+                const CompactLatticeArc &arc = aiter.Value();
+                terms.push_back(beta[arc.nextstate] - (arc.weight.Weight().Value1() + arc.weight.Weight().Value2()));
+            }
+            beta[s] = LogSumExp(terms);
+            if(beta[s] == kLogZeroDouble)
+                continue;  // No path to a final state.
+
+            // Pushed arcs: cost of the arc given that the path goes through s.
+            arcs.clear();
+            size_t t = 0;
+            if(final_weight != CompactLatticeWeight::Zero()) {
+                PostArc arc;
+                arc.label = 0;
+                arc.next_class = kFinalClass;
+                arc.weight = beta[s] - terms[t++];
+                arcs.push_back(arc);
+            }
+            for(fst::ArcIterator<CompactLattice> aiter(clat, s); !aiter.Done(); aiter.Next(), t++) {
+                StateId next = aiter.Value().nextstate;
+                if(state_class[next] < 0)
+                    continue;
+                PostArc arc;
+                arc.label = aiter.Value().olabel;
+                arc.next_class = state_class[next];
+                arc.weight = beta[s] - terms[t];
+                arcs.push_back(arc);
+            }
+
+            // States with the same pushed arcs (the weights compared as fst::Minimize
+            // quantizes them) to the same classes are equivalent.
+            int32 height = 0;
+            for(size_t a = 0; a < arcs.size(); a++) {
+                arcs[a].quantized_weight = static_cast<int64>(std::floor(arcs[a].weight / fst::kDelta + 0.5));
+                height = std::max(height, class_height[arcs[a].next_class] + 1);
+            }
+            std::sort(arcs.begin(), arcs.end());
+
+            signature.clear();
+            for(size_t a = 0; a < arcs.size(); a++) {
+                signature.push_back(arcs[a].label);
+                signature.push_back(arcs[a].next_class);
+                signature.push_back(arcs[a].quantized_weight);
+            }
+
+            std::unordered_map<std::vector<int64>, int32, SignatureHash>::iterator it = classes.find(signature);
+            if(it != classes.end()) {
+                state_class[s] = it->second;
+            } else {
+                state_class[s] = class_arcs.size();
+                classes[signature] = class_arcs.size();
+                class_arcs.push_back(arcs);
+                class_height.push_back(height);
+            }
+        }
+
+        StateId start = clat.Start();
+        if(state_class[start] < 0)
+            return kLogZeroDouble;
+
+        // Arcs go to lower heights, so ordering by decreasing height sorts the
+        // result topologically; the start is the only state of the largest.
+        int32 num_classes = class_arcs.size();
+        std::vector<int32> class_order(num_classes);
+        for(int32 c = 0; c < num_classes; c++) {
+            class_order[c] = c;
+        }
+        std::stable_sort(class_order.begin(), class_order.end(), [&class_height](int32 a, int32 b) {
+            return class_height[a] > class_height[b];
+        });
+
+        std::vector<StateId> class_state(num_classes);
+        for(int32 i = 0; i < num_classes; i++) {
+            class_state[class_order[i]] = i;
+        }
+
+        pst->ReserveStates(num_classes);
+        for(int32 i = 0; i < num_classes; i++) {
+            pst->AddState();
+        }
+        for(int32 c = 0; c < num_classes; c++) {
+            const std::vector<PostArc> &c_arcs = class_arcs[c];
+            pst->ReserveArcs(class_state[c], c_arcs.size());
+            for(size_t a = 0; a < c_arcs.size(); a++) {
+                pst->AddArc(class_state[c], fst::LogArc(c_arcs[a].label, c_arcs[a].label,
+                                                        fst::LogWeight(c_arcs[a].weight),
+                                                        class_state[c_arcs[a].next_class]));
+            }
+        }
+        pst->SetStart(class_state[state_class[start]]);
+        pst->SetFinal(class_state[kFinalClass], fst::LogWeight::One());
+
+        return beta[start];
+    }
+}
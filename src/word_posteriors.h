@@ -0,0 +1,27 @@
+#ifndef ALEX_ASR_WORD_POSTERIORS_H_
+#define ALEX_ASR_WORD_POSTERIORS_H_
+
+#include "base/kaldi-common.h"
+#include "fst/fstlib.h"
+#include "lat/kaldi-lattice.h"
+
+using namespace kaldi;
+
+namespace alex_asr {
+    // Converts a word lattice to the posterior lattice of Decoder::GetLattice:
+    // the minimal acceptor of the words (alignments and the graph/acoustic
+    // split dropped), with a single final state, topologically sorted (start
+    // is state 0) and pushed so that the arc weights are the negative log
+    // probabilities of taking the arcs from their states. Returns the total
+    // log-likelihood of the lattice.
+    //
+    // The result is the same as CompactLatticeToWordsPost() (up to the
+    // quantization of fst::Minimize) but it takes only a depth-first search
+    // and one backward pass over the lattice: the backward pass computes the
+    // pushed weights and merges equivalent states on the way, which minimizes
+    // an acyclic automaton. Cyclic lattices fall back to
+    // CompactLatticeToWordsPost().
+    double CompactLatticeToWordPosteriors(const CompactLattice &clat, fst::VectorFst<fst::LogArc> *pst);
+}
+
+#endif  // ALEX_ASR_WORD_POSTERIORS_H_
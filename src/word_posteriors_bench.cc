@@ -0,0 +1,97 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include "base/kaldi-common.h"
+#include "util/common-utils.h"
+#include "lat/kaldi-lattice.h"
+#include "lat/lattice-functions.h"
+
+#include "src/tool_utils.h"
+#include "src/utils.h"
+#include "src/word_posteriors.h"
+
+using namespace kaldi;
+using namespace alex_asr;
+
+typedef std::chrono::steady_clock Clock;
+
+int main(int argc, char *argv[]) {
+    try {
+        const char *usage =
+                "Compare the word posterior lattices of Decoder::GetLattice (CompactLatticeToWordPosteriors)\n"
+                "with the previous conversion (CompactLatticeToWordsPost) and report the time of both.\n"
+                "\n"
+                "Usage: word_posteriors_bench [options] <lattice-rspecifier>\n"
+                " e.g.: word_posteriors_bench --acoustic-scale=0.1 'ark:gunzip -c lat.1.gz|'\n";
+
+        ParseOptions po(usage);
+        BaseFloat acoustic_scale = 1.0;
+        int32 num_repeats = 10;
+        po.Register("acoustic-scale", &acoustic_scale, "Scale of the acoustic costs (as in the decoder's lattices).");
+        po.Register("num-repeats", &num_repeats, "Number of times each lattice is converted by both methods.");
+        po.Read(argc, argv);
+
+        if (po.NumArgs() != 1 || num_repeats < 1) {
+            po.PrintUsage();
+            return 1;
+        }
+
+        int32 num_lattices = 0, num_size_mismatches = 0;
+        int64 num_arcs = 0;
+        double reference_seconds = 0.0, fast_seconds = 0.0, max_lik_diff = 0.0;
+        SequentialCompactLatticeReader lattice_reader(po.GetArg(1));
+        for (; !lattice_reader.Done(); lattice_reader.Next()) {
+            CompactLattice clat = lattice_reader.Value();
+            if (acoustic_scale != 1.0)
+                fst::ScaleLattice(fst::AcousticLatticeScale(acoustic_scale), &clat);
+            if (clat.Start() == fst::kNoStateId)
+                continue;
+
+            fst::VectorFst<fst::LogArc> reference, fast;
+            double reference_lik = 0.0, fast_lik = 0.0;
+
+            Clock::time_point start = Clock::now();
+            for (int32 i = 0; i < num_repeats; i++) {
+                // The reference conversion modifies its input.
+                CompactLattice copy(clat);
+                reference_lik = CompactLatticeToWordsPost(copy, &reference);
+            }
+            reference_seconds += SecondsSince(start);
+
+            start = Clock::now();
+            for (int32 i = 0; i < num_repeats; i++) {
+                CompactLattice copy(clat);  // Copied as well, so that both timings include it.
+                fast_lik = CompactLatticeToWordPosteriors(copy, &fast);
+            }
+            fast_seconds += SecondsSince(start);
+
+            max_lik_diff = std::max(max_lik_diff, std::abs(reference_lik - fast_lik));
+            if (reference.NumStates() != fast.NumStates()) {
+                KALDI_WARN << "Lattice " << lattice_reader.Key() << ": " << reference.NumStates()
+                           << " states with CompactLatticeToWordsPost, " << fast.NumStates() << " now.";
+                num_size_mismatches++;
+            }
+            num_lattices++;
+            for (fst::StateIterator<CompactLattice> siter(clat); !siter.Done(); siter.Next())
+                num_arcs += clat.NumArcs(siter.Value());
+        }
+
+        if (num_lattices == 0)
+            KALDI_ERR << "No lattices to compare.";
+
+        KALDI_LOG << "Converted " << num_lattices << " lattices with " << num_arcs << " arcs "
+                  << num_repeats << " times each.";
+        KALDI_LOG << "Largest difference of the total log-likelihoods: " << max_lik_diff;
+        KALDI_LOG << "Lattices with a different number of states: " << num_size_mismatches;
+        KALDI_LOG << "Time per lattice: CompactLatticeToWordsPost "
+                  << 1000.0 * reference_seconds / (num_lattices * num_repeats) << " ms, CompactLatticeToWordPosteriors "
+                  << 1000.0 * fast_seconds / (num_lattices * num_repeats) << " ms ("
+                  << reference_seconds / fast_seconds << "x faster).";
+
+        return 0;
+    } catch (const std::exception &e) {
+        std::cerr << e.what();
+        return -1;
+    }
+}
@@ -0,0 +1,59 @@
+#include <algorithm>
+#include <limits>
+
+#include "src/word_table.h"
+
+using namespace kaldi;
+
+namespace alex_asr {
+    WordTable::WordTable(const fst::SymbolTable &symbols) {
+        int64 num_ids = 0;
+        size_t num_bytes = 0;
+        for(fst::SymbolTableIterator it(symbols); !it.Done(); it.Next()) {
+            if(it.Value() < 0) {
+                KALDI_ERR << "Negative word id " << it.Value() << " in the word table.";
+            }
+            num_ids = std::max<int64>(num_ids, it.Value() + 1);
+            num_bytes += it.Symbol().size();
+        }
+        const int32 max_size = std::numeric_limits<int32>::max();
+        if(num_ids >= max_size || num_bytes >= static_cast<size_t>(max_size)) {
+            KALDI_ERR << "The word table is too large.";
+        }
+
+        // The symbol table need not be sorted by id, so the words are placed
+        // into their slots in a second pass.
+        std::vector<int32> lengths(num_ids, 0);
+        for(fst::SymbolTableIterator it(symbols); !it.Done(); it.Next()) {
+            lengths[it.Value()] = it.Symbol().size();
+        }
+
+        offsets_.resize(num_ids + 1);
+        offsets_[0] = 0;
+        for(int64 w = 0; w < num_ids; w++) {
+            offsets_[w + 1] = offsets_[w] + lengths[w];
+        }
+
+        arena_.resize(num_bytes);
+        for(fst::SymbolTableIterator it(symbols); !it.Done(); it.Next()) {
+            std::string word = it.Symbol();
+            std::copy(word.begin(), word.end(), arena_.begin() + offsets_[it.Value()]);
+        }
+    }
+
+    std::string WordTable::Word(int32 word_id) const {
+        if(word_id < 0 || word_id >= NumIds())
+            return std::string();
+        return std::string(arena_.begin() + offsets_[word_id], arena_.begin() + offsets_[word_id + 1]);
+    }
+
+    void WordTable::AppendText(const int32 *word_ids, size_t num_words, std::string *text) const {
+        for(size_t i = 0; i < num_words; i++) {
+            int32 w = word_ids[i];
+            if(i > 0)
+                text->push_back(' ');
+            if(w >= 0 && w < NumIds())
+                text->append(arena_.begin() + offsets_[w], arena_.begin() + offsets_[w + 1]);
+        }
+    }
+}
@@ -0,0 +1,40 @@
+#ifndef ALEX_ASR_WORD_TABLE_H_
+#define ALEX_ASR_WORD_TABLE_H_
+
+#include <string>
+#include <vector>
+
+#include "fst/symbol-table.h"
+#include "base/kaldi-common.h"
+
+using namespace kaldi;
+
+namespace alex_asr {
+    // The words of a symbol table in one contiguous arena, indexed by word id:
+    // word w is Data()[Offset(w)] .. Data()[Offset(w + 1) - 1]. Ids that are
+    // not in the symbol table have empty words. Turning hypotheses to text is
+    // then a few memcpy()s without hashing or allocating per word.
+    class WordTable {
+    public:
+        explicit WordTable(const fst::SymbolTable &symbols);
+
+        // Word ids are in [0, NumIds()).
+        int32 NumIds() const { return offsets_.size() - 1; }
+        const char *Data() const { return arena_.empty() ? NULL : &arena_[0]; }
+        int32 Offset(int32 word_id) const { return offsets_[word_id]; }
+        const std::vector<int32> &Offsets() const { return offsets_; }
+
+        // Empty for unknown ids.
+        std::string Word(int32 word_id) const;
+        // Appends the words, separated by spaces, to text.
+        void AppendText(const int32 *word_ids, size_t num_words, std::string *text) const;
+        void AppendText(const std::vector<int32> &word_ids, std::string *text) const {
+            AppendText(word_ids.data(), word_ids.size(), text);
+        }
+    private:
+        std::vector<char> arena_;
+        std::vector<int32> offsets_;
+    };
+}
+
+#endif  // ALEX_ASR_WORD_TABLE_H_
@@ -8,7 +8,7 @@ MODEL_PATH = "asr_model_digits"
 
 
 def word_ids_to_str_hyp(decoder, word_ids):
-    return" ".join(decoder.get_word(word_id).decode('utf8') for word_id in word_ids)
+    return decoder.words_to_text(word_ids)
 
 
 if __name__ == "__main__":